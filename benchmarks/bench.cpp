@@ -0,0 +1,264 @@
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(_WIN32)
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+
+    #pragma comment(lib, "Ws2_32.lib")
+#else
+    #include <arpa/inet.h>
+    #include <netinet/in.h>
+    #include <sys/socket.h>
+#endif
+
+#include <benchmark/benchmark.h>
+
+#include <color_transform.hpp>
+#include <event_loop.hpp>
+#include <fake_driver.hpp>
+#include <ledriver.hpp>
+#include <shared_socket.hpp>
+#include <tools.hpp>
+
+namespace {
+
+sockaddr_storage loopback() {
+    sockaddr_storage ss{};
+    sockaddr_in& in = reinterpret_cast<sockaddr_in&>(ss);
+    in.sin_family = AF_INET;
+    in.sin_addr.s_addr = ::htonl(INADDR_LOOPBACK);
+    return ss;
+}
+
+//! Simulated driver on the loopback interface, served on a background thread.
+LEDriver::FakeDriver& driver() {
+    static LEDriver::FakeDriver instance(1, loopback());
+    static const bool started = (instance.start(), true);
+    (void)started;
+    return instance;
+}
+
+//! Report p50/p99 latency in microseconds and the achieved frame rate.
+void report_latency(benchmark::State& state, std::vector<std::chrono::nanoseconds>& samples) {
+    if (samples.empty())
+        return;
+
+    std::sort(samples.begin(), samples.end());
+    const auto percentile = [&](double p) {
+        const auto index = static_cast<std::size_t>(p * static_cast<double>(samples.size() - 1));
+        return std::chrono::duration<double, std::micro>(samples[index]).count();
+    };
+
+    state.counters["p50_us"] = percentile(0.50);
+    state.counters["p99_us"] = percentile(0.99);
+    state.counters["fps"] = benchmark::Counter(static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+}
+
+void BM_SerializeU16(benchmark::State& state) {
+    std::uint16_t value = 0x1234;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(value = SERIALIZE_U16(value));
+    }
+}
+BENCHMARK(BM_SerializeU16);
+
+void BM_SerializeU32(benchmark::State& state) {
+    std::uint32_t value = 0x12345678;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(value = SERIALIZE_U32(value));
+    }
+}
+BENCHMARK(BM_SerializeU32);
+
+void BM_BuildHeader(benchmark::State& state) {
+    std::uint16_t sequence{};
+    for (auto _ : state) {
+        LEDriver::RootHeader header = MAKE_HEADER(LEDriver::Action::UPDATE, sequence++);
+        benchmark::DoNotOptimize(header);
+    }
+}
+BENCHMARK(BM_BuildHeader);
+
+void BM_BuildUpdateFrame(benchmark::State& state) {
+    std::uint16_t value{};
+    for (auto _ : state) {
+        auto frame = UPDATE_FRAME;
+        frame.set<0>({value, value, value});
+        value++;
+        benchmark::DoNotOptimize(frame);
+    }
+}
+BENCHMARK(BM_BuildUpdateFrame);
+
+void BM_TransformFloat(benchmark::State& state) {
+    const LEDriver::ColorTransform transform(2.2f, 0.8f);
+    std::vector<float> rgb(3 * static_cast<std::size_t>(state.range(0)));
+    for (std::size_t i = 0; i < rgb.size(); i++)
+        rgb[i] = static_cast<float>(i % 101) / 100.0f;
+    std::vector<std::byte> out(2 * rgb.size());
+
+    for (auto _ : state) {
+        transform.transform(rgb, out);
+        benchmark::DoNotOptimize(out.data());
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_TransformFloat)->Arg(300)->Arg(1000);
+
+void BM_TransformBytes(benchmark::State& state) {
+    const LEDriver::ColorTransform transform(2.2f, 0.8f);
+    std::vector<std::uint8_t> rgb(3 * static_cast<std::size_t>(state.range(0)));
+    for (std::size_t i = 0; i < rgb.size(); i++)
+        rgb[i] = static_cast<std::uint8_t>(i);
+    std::vector<std::byte> out(2 * rgb.size());
+
+    for (auto _ : state) {
+        transform.transform(rgb, out);
+        benchmark::DoNotOptimize(out.data());
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_TransformBytes)->Arg(300)->Arg(1000);
+
+void BM_Update(benchmark::State& state) {
+    LEDriver::Controller ctl(driver().address(0));
+
+    // Alternate colors, so the dedupe never skips a frame.
+    std::uint16_t value{};
+    for (auto _ : state)
+        ctl.update({++value, 0, 0});
+
+    state.counters["fps"] = benchmark::Counter(static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_Update);
+
+void BM_UpdateDeduped(benchmark::State& state) {
+    LEDriver::Controller ctl(driver().address(0));
+    ctl.update({1, 2, 3});
+
+    for (auto _ : state)
+        ctl.update({1, 2, 3});
+}
+BENCHMARK(BM_UpdateDeduped);
+
+void BM_Power(benchmark::State& state) {
+    LEDriver::Controller ctl(driver().address(0));
+
+    bool on{};
+    for (auto _ : state)
+        ctl.power(on = !on);
+
+    state.counters["fps"] = benchmark::Counter(static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_Power);
+
+void BM_UpdatePixels(benchmark::State& state) {
+    LEDriver::Controller ctl(driver().address(0));
+    std::vector<LEDriver::ColorState> pixels(static_cast<std::size_t>(state.range(0)));
+
+    for (auto _ : state)
+        ctl.update_pixels(pixels);
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_UpdatePixels)->Arg(60)->Arg(300)->Arg(1000);
+
+void BM_UpdatePixelsDelta(benchmark::State& state) {
+    LEDriver::Controller ctl(driver().address(0));
+    std::vector<LEDriver::ColorState> pixels(300);
+
+    // Change a few pixels per frame, as a typical animation does.
+    std::uint16_t value{};
+    for (auto _ : state) {
+        value++;
+        for (std::size_t i = 0; i < 4; i++)
+            pixels[(value * 7 + i * 61) % pixels.size()] = {value, 0, 0};
+        ctl.update_pixels_delta(pixels);
+    }
+
+    state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(pixels.size()));
+}
+BENCHMARK(BM_UpdatePixelsDelta);
+
+void BM_PingRoundTrip(benchmark::State& state) {
+    LEDriver::Controller ctl(driver().address(0));
+
+    std::vector<std::chrono::nanoseconds> samples;
+    samples.reserve(1 << 16);
+
+    for (auto _ : state) {
+        const auto start = std::chrono::steady_clock::now();
+        if (!ctl.ping())
+            state.SkipWithError("no PONG");
+        if (samples.size() < samples.capacity())
+            samples.push_back(std::chrono::steady_clock::now() - start);
+    }
+
+    report_latency(state, samples);
+}
+BENCHMARK(BM_PingRoundTrip)->UseRealTime();
+
+void BM_StatusRoundTrip(benchmark::State& state) {
+    LEDriver::Controller ctl(driver().address(0));
+
+    std::vector<std::chrono::nanoseconds> samples;
+    samples.reserve(1 << 16);
+
+    for (auto _ : state) {
+        const auto start = std::chrono::steady_clock::now();
+        benchmark::DoNotOptimize(ctl.status());
+        if (samples.size() < samples.capacity())
+            samples.push_back(std::chrono::steady_clock::now() - start);
+    }
+
+    report_latency(state, samples);
+}
+BENCHMARK(BM_StatusRoundTrip)->UseRealTime();
+
+// A fleet-wide poll: one STATUS and one PING request per driver in flight at once, all on one `SharedSocket`.
+void BM_EventLoopPoll(benchmark::State& state) {
+    const auto drivers = static_cast<std::size_t>(state.range(0));
+
+    LEDriver::FakeDriver fleet(drivers, loopback());
+    fleet.start();
+
+    const auto shared = std::make_shared<LEDriver::SharedSocket>(AF_INET);
+    std::vector<LEDriver::Controller> controllers;
+    controllers.reserve(drivers);
+    for (std::size_t i = 0; i < drivers; i++)
+        controllers.emplace_back(shared, fleet.address(i));
+
+    LEDriver::EventLoop loop;
+    std::size_t lost{};
+
+    for (auto _ : state) {
+        for (LEDriver::Controller& ctl : controllers) {
+            loop.status(ctl, [&](std::optional<LEDriver::Status> status, std::chrono::nanoseconds) {
+                if (!status)
+                    lost++;
+            });
+            loop.ping(ctl, [&](bool pong, std::chrono::nanoseconds) {
+                if (!pong)
+                    lost++;
+            });
+        }
+        loop.run();
+    }
+
+    state.counters["lost"] = static_cast<double>(lost);
+    state.SetItemsProcessed(state.iterations() * 2 * state.range(0));
+}
+BENCHMARK(BM_EventLoopPoll)->Arg(1000)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+} // namespace
+
+BENCHMARK_MAIN();
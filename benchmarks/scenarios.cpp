@@ -0,0 +1,324 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+#if defined(_WIN32)
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+
+    #include <windows.h>
+
+    #include <psapi.h>
+
+    #pragma comment(lib, "Ws2_32.lib")
+    #pragma comment(lib, "psapi.lib")
+#else
+    #include <arpa/inet.h>
+    #include <netinet/in.h>
+    #include <sys/resource.h>
+    #include <sys/socket.h>
+    #include <time.h>
+    #include <unistd.h>
+#endif
+
+#include <benchmark/benchmark.h>
+
+#include <fake_driver.hpp>
+#include <group.hpp>
+#include <ledriver.hpp>
+#include <shared_socket.hpp>
+
+/*
+    End-to-end scenarios: a fleet of simulated drivers is animated at a fixed rate for a while, optionally polled with
+    PING/STATUS, over a lossy loopback. Every scenario runs once, for LEDRIVER_SCENARIO_SECONDS (default 1) seconds.
+
+    Arguments: number of drivers, update rate (Hz), send path (see `Path`), injected loss (%), polls per tick.
+
+    Counters:
+    - fps, target_fps: frames sent per second, achieved and requested
+    - cpu_ns_per_frame: CPU time of the sending thread per frame, polling excluded
+    - rss_mb: resident memory of the process, the simulated fleet included
+    - skew_p99_us: 99th percentile of the time from the start of a tick to a sampled driver applying its color
+    - late_pct: sampled frames not applied before the next tick (lost, or the fleet could not keep up)
+    - stale_p99_ms: 99th percentile of the age of a driver's previous status when a poll refreshes it
+    - poll_timeouts: polls without a reply
+
+    The batched path goes through `ControllerGroup`, i.e. `sendmmsg()` or, built with LEDRIVER_IO_URING, io_uring;
+    the label tells which.
+*/
+
+namespace {
+
+//! Send paths compared by the scenarios.
+enum Path : std::int64_t {
+    per_socket = 0,    //!< `Controller::update()`, every controller on its own socket.
+    shared_socket = 1, //!< `Controller::update()`, all controllers on one `SharedSocket`.
+    batched = 2        //!< `ControllerGroup`, controllers on one `SharedSocket` for polling.
+};
+
+//! Number of drivers sampled per tick for the presentation skew.
+constexpr std::size_t skew_samples = 64;
+
+//! Reply timeout of polls. Loopback round trips take tens of microseconds.
+constexpr std::chrono::milliseconds poll_timeout(2);
+
+sockaddr_storage loopback() {
+    sockaddr_storage ss{};
+    sockaddr_in& in = reinterpret_cast<sockaddr_in&>(ss);
+    in.sin_family = AF_INET;
+    in.sin_addr.s_addr = ::htonl(INADDR_LOOPBACK);
+    return ss;
+}
+
+std::chrono::nanoseconds scenario_duration() {
+    const char* seconds = std::getenv("LEDRIVER_SCENARIO_SECONDS");
+    const double value = seconds ? std::atof(seconds) : 0.0;
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::duration<double>(value > 0 ? value : 1.0));
+}
+
+//! CPU time consumed by the calling thread.
+std::chrono::nanoseconds thread_cpu_time() {
+#if defined(_WIN32)
+    FILETIME creation, exit, kernel, user;
+    ::GetThreadTimes(::GetCurrentThread(), &creation, &exit, &kernel, &user);
+
+    const auto ticks = [](const FILETIME& time) {
+        return static_cast<std::int64_t>(time.dwHighDateTime) << 32 | time.dwLowDateTime;
+    };
+    return std::chrono::nanoseconds((ticks(kernel) + ticks(user)) * 100);
+#else
+    timespec time{};
+    ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+    return std::chrono::seconds(time.tv_sec) + std::chrono::nanoseconds(time.tv_nsec);
+#endif
+}
+
+//! Resident memory of the process in bytes. Peak resident memory where the current one is not available.
+double resident_bytes() {
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters{};
+    ::GetProcessMemoryInfo(::GetCurrentProcess(), &counters, sizeof(counters));
+    return static_cast<double>(counters.WorkingSetSize);
+#elif defined(__linux__)
+    long pages{};
+    if (std::FILE* statm = std::fopen("/proc/self/statm", "r")) {
+        if (std::fscanf(statm, "%*s %ld", &pages) != 1)
+            pages = 0;
+        std::fclose(statm);
+    }
+    return static_cast<double>(pages) * static_cast<double>(::sysconf(_SC_PAGESIZE));
+#else
+    rusage usage{};
+    ::getrusage(RUSAGE_SELF, &usage);
+    #if defined(__APPLE__)
+    return static_cast<double>(usage.ru_maxrss);
+    #else
+    return static_cast<double>(usage.ru_maxrss) * 1024.0;
+    #endif
+#endif
+}
+
+double percentile(std::vector<double>& samples, double p) {
+    if (samples.empty())
+        return 0.0;
+
+    std::sort(samples.begin(), samples.end());
+    return samples[static_cast<std::size_t>(p * static_cast<double>(samples.size() - 1))];
+}
+
+const char* path_label(std::int64_t path) {
+    switch (path) {
+    case per_socket:
+        return "per-socket";
+    case shared_socket:
+        return "shared-socket";
+    default:
+#if defined(LEDRIVER_IO_URING)
+        return "batched/io_uring";
+#elif defined(__linux__)
+        return "batched/sendmmsg";
+#else
+        return "batched/sendto";
+#endif
+    }
+}
+
+void BM_Scenario(benchmark::State& state) {
+    using clock = std::chrono::steady_clock;
+
+    const auto drivers = static_cast<std::size_t>(state.range(0));
+    const auto hz = state.range(1);
+    const auto path = state.range(2);
+    const auto loss = static_cast<double>(state.range(3)) / 100.0;
+    const auto polls = static_cast<std::size_t>(state.range(4));
+
+    state.SetLabel(path_label(path));
+
+    for (auto _ : state) {
+        try {
+            LEDriver::FakeDriverOptions options;
+            options.loss = loss;
+
+            LEDriver::FakeDriver fleet(drivers, loopback(), options);
+            fleet.start();
+
+            std::shared_ptr<LEDriver::SharedSocket> shared;
+            if (path != per_socket)
+                shared = std::make_shared<LEDriver::SharedSocket>(AF_INET);
+
+            std::vector<LEDriver::Controller> controllers;
+            controllers.reserve(drivers);
+            for (std::size_t i = 0; i < drivers; i++) {
+                if (shared)
+                    controllers.emplace_back(shared, fleet.address(i), poll_timeout);
+                else
+                    controllers.emplace_back(fleet.address(i), poll_timeout);
+            }
+
+            LEDriver::ControllerGroup group;
+
+            const std::size_t step = std::max<std::size_t>(1, drivers / skew_samples);
+            const auto period = std::chrono::nanoseconds(std::chrono::seconds(1)) / hz;
+
+            std::vector<double> skew;
+            std::vector<double> staleness;
+            std::size_t probes{};
+            std::size_t late{};
+            std::size_t timeouts{};
+            std::size_t frames{};
+            std::size_t cursor{};
+            std::chrono::nanoseconds cpu{};
+
+            const auto start = clock::now();
+            const auto end = start + scenario_duration();
+            std::vector<clock::time_point> refreshed(drivers, start);
+
+            std::uint16_t value{};
+            clock::time_point previous{};
+            auto next = start;
+
+            while (next < end) {
+                const auto tick = clock::now();
+
+                // Sampled drivers should show the color of the previous tick by now.
+                if (previous != clock::time_point{}) {
+                    for (std::size_t i = 0; i < drivers; i += step) {
+                        probes++;
+                        if (fleet.status(i).color.r == value)
+                            skew.push_back(std::chrono::duration<double, std::micro>(fleet.applied_at(i) - previous)
+                                               .count());
+                        else
+                            late++;
+                    }
+                }
+
+                // A new color every tick, so the dedupe never skips a frame.
+                const LEDriver::ColorState color{++value, 0, 0};
+                const auto cpu_start = thread_cpu_time();
+
+                if (path == batched) {
+                    for (LEDriver::Controller& ctl : controllers)
+                        group.update(ctl, color);
+                    frames += group.flush();
+                } else {
+                    for (LEDriver::Controller& ctl : controllers)
+                        ctl.update(color);
+                    frames += drivers;
+                }
+
+                cpu += thread_cpu_time() - cpu_start;
+                previous = tick;
+
+                // Round-robin polling, alternating PING and STATUS.
+                for (std::size_t p = 0; p < polls; p++) {
+                    const std::size_t i = cursor++ % drivers;
+                    try {
+                        bool replied = true;
+                        if (p % 2)
+                            controllers[i].status();
+                        else
+                            replied = controllers[i].ping();
+
+                        if (!replied) {
+                            timeouts++;
+                            continue;
+                        }
+
+                        const auto now = clock::now();
+                        staleness.push_back(std::chrono::duration<double, std::milli>(now - refreshed[i]).count());
+                        refreshed[i] = now;
+                    } catch (const std::system_error&) {
+                        timeouts++;
+                    }
+                }
+
+                // Ticks which cannot keep up are skipped, as `FrameScheduler` does.
+                next += period;
+                if (const auto now = clock::now(); next < now)
+                    next = now;
+                std::this_thread::sleep_until(next);
+            }
+
+            const double elapsed = std::chrono::duration<double>(clock::now() - start).count();
+
+            state.counters["fps"] = static_cast<double>(frames) / elapsed;
+            state.counters["target_fps"] = static_cast<double>(drivers) * static_cast<double>(hz);
+            state.counters["cpu_ns_per_frame"] = frames ? static_cast<double>(cpu.count()) / static_cast<double>(frames)
+                                                        : 0.0;
+            state.counters["rss_mb"] = resident_bytes() / (1024.0 * 1024.0);
+            state.counters["skew_p99_us"] = percentile(skew, 0.99);
+            state.counters["late_pct"] = probes ? 100.0 * static_cast<double>(late) / static_cast<double>(probes) : 0.0;
+            if (polls) {
+                state.counters["stale_p99_ms"] = percentile(staleness, 0.99);
+                state.counters["poll_timeouts"] = static_cast<double>(timeouts);
+            }
+        } catch (const std::system_error& se) {
+            // E.g. too many open files for 10000 drivers with a socket per controller.
+            state.SkipWithError(se.what());
+            return;
+        }
+    }
+}
+
+void scenarios(benchmark::internal::Benchmark* benchmark) {
+    benchmark->ArgNames({"drivers", "hz", "path", "loss_pct", "polls"});
+
+    for (const std::int64_t drivers : {10, 100, 1000, 10000})
+        for (const std::int64_t hz : {30, 100, 1000})
+            for (const std::int64_t path : {per_socket, shared_socket, batched}) {
+                benchmark->Args({drivers, hz, path, 0, 0}); // Animation only.
+                benchmark->Args({drivers, hz, path, 0, 4}); // Mixed PING/STATUS polling.
+                benchmark->Args({drivers, hz, path, 5, 4}); // Polling over a lossy network.
+            }
+}
+BENCHMARK(BM_Scenario)->Apply(scenarios)->Iterations(1)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+} // namespace
+
+int main(int argc, char** argv) {
+#if !defined(_WIN32)
+    // 10000 simulated drivers and as many controllers need more descriptors than the usual soft limit.
+    rlimit limit{};
+    if (::getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+        limit.rlim_cur = limit.rlim_max;
+        ::setrlimit(RLIMIT_NOFILE, &limit);
+    }
+#endif
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
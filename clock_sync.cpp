@@ -0,0 +1,94 @@
+#include <chrono>
+#include <mutex>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <ledriver.hpp>
+#include <metrics.hpp>
+#include <tools.hpp>
+
+std::chrono::nanoseconds LEDriver::Controller::sync_clock(std::size_t samples) {
+    if (!is_valid())
+        throw std::system_error(ENOTCONN, std::generic_category());
+
+    if (samples == 0)
+        throw std::system_error(EINVAL, std::generic_category());
+
+    // Keep concurrent exchanges from reading each other's replies.
+    const std::lock_guard lock(exchange_mutex_);
+
+    Metrics* metrics = metrics_.load(std::memory_order_acquire);
+
+    bool found{};
+    bool untimed{};
+    std::chrono::nanoseconds best_rtt{};
+    std::int64_t best_offset{};
+
+    for (std::size_t i = 0; i < samples; i++) {
+        const auto flags = static_cast<std::uint16_t>(next_sequence_() | RootHeader::flag_timestamp);
+        const RootHeader ping_header = MAKE_HEADER(Action::PING, flags);
+        const auto sent = std::chrono::steady_clock::now();
+
+        send_({TO_CIOV(ping_header)});
+
+        std::byte buffer[TimedPongFrame::size];
+        std::size_t size;
+        try {
+            size = recv_reply_(ping_header, buffer);
+        } catch (const std::system_error& se) {
+            if (IS_TIMEOUT(se.code().value()))
+                continue;
+            throw;
+        }
+
+        const auto received = std::chrono::steady_clock::now();
+
+        // A driver without timestamp support echoes the bare header.
+        if (!TimedPongFrame::is_reply({buffer, size}, ping_header)) {
+            untimed = true;
+            continue;
+        }
+
+        const auto [driver_time] = TimedPongFrame::decode(buffer);
+        const auto rtt = received - sent;
+
+        if (metrics)
+            metrics->rtt_(Action::PING, rtt);
+
+        if (found && rtt >= best_rtt)
+            continue;
+
+        // The driver is assumed to have read its clock halfway through the round trip.
+        const auto midpoint =
+            std::chrono::duration_cast<std::chrono::microseconds>((sent + rtt / 2).time_since_epoch());
+
+        found = true;
+        best_rtt = rtt;
+        best_offset = static_cast<std::int64_t>(driver_time) - midpoint.count();
+    }
+
+    if (!found) {
+        if (untimed)
+            throw std::system_error(EIO, std::generic_category());
+        throw std::system_error(TIMEOUT_ERROR(), std::system_category(), "recv");
+    }
+
+    clock_offset_.store(best_offset, std::memory_order_release);
+    return best_rtt;
+}
+
+bool LEDriver::Controller::clock_synced() const noexcept {
+    return clock_offset_.load(std::memory_order_acquire) != clock_unsynced;
+}
+
+std::uint64_t LEDriver::Controller::to_driver_time(std::chrono::steady_clock::time_point time) const {
+    const std::int64_t offset = clock_offset_.load(std::memory_order_acquire);
+    if (offset == clock_unsynced)
+        throw std::system_error(EINVAL, std::generic_category());
+
+    // Times before the driver's epoch are in the past anyway, so present them at once.
+    const auto local = std::chrono::duration_cast<std::chrono::microseconds>(time.time_since_epoch()).count();
+    const std::int64_t driver = local + offset;
+    return driver < 0 ? 0 : static_cast<std::uint64_t>(driver);
+}
\ No newline at end of file
@@ -0,0 +1,160 @@
+#include <array>
+#include <cmath>
+#include <span>
+#include <system_error>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+    #include <emmintrin.h>
+#elif defined(__ARM_NEON)
+    #include <arm_neon.h>
+#endif
+
+#include <color_transform.hpp>
+#include <tools.hpp>
+
+namespace {
+
+constexpr float max_index = static_cast<float>(LEDriver::ColorTransform::float_steps - 1);
+
+//! Quantize one channel. NaN clamps to 1, like `_mm_min_ps()` does.
+inline std::uint32_t QUANTIZE(float channel) noexcept {
+    channel = channel < 1.0f ? channel : 1.0f;
+    channel = channel > 0.0f ? channel : 0.0f;
+    return static_cast<std::uint32_t>(channel * max_index + 0.5f);
+}
+
+} // namespace
+
+LEDriver::ColorTransform::ColorTransform(float gamma, float brightness) : gamma_(gamma), brightness_(brightness) {
+    if (!(gamma > 0.0f) || !(brightness >= 0.0f && brightness <= 1.0f))
+        throw std::system_error(EINVAL, std::generic_category());
+
+    build_();
+}
+
+void LEDriver::ColorTransform::set_brightness(float brightness) {
+    if (!(brightness >= 0.0f && brightness <= 1.0f))
+        throw std::system_error(EINVAL, std::generic_category());
+
+    brightness_ = brightness;
+    build_();
+}
+
+float LEDriver::ColorTransform::gamma() const noexcept {
+    return gamma_;
+}
+
+float LEDriver::ColorTransform::brightness() const noexcept {
+    return brightness_;
+}
+
+void LEDriver::ColorTransform::transform(std::span<const float> rgb, std::span<std::byte> out) const {
+    if (rgb.size() % 3 != 0 || out.size() != rgb.size() * 2)
+        throw std::system_error(EINVAL, std::generic_category());
+
+    const std::size_t count = rgb.size();
+    const float* in = rgb.data();
+    std::byte* at = out.data();
+    std::size_t i{};
+
+    // Channels are independent of the pixel boundaries, so the interleaved input is processed as a flat array.
+#if defined(__AVX2__)
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 scale = _mm256_set1_ps(max_index);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256i low = _mm256_set1_epi32(0xFFFF);
+    const auto* lut = reinterpret_cast<const int*>(float_lut_.data());
+
+    for (; i + 16 <= count; i += 16) {
+        __m256i words[2];
+        for (int j = 0; j < 2; j++) {
+            __m256 x = _mm256_loadu_ps(in + i + 8 * j);
+            x = _mm256_max_ps(_mm256_min_ps(x, one), zero);
+            const __m256i index = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(x, scale), half));
+
+            // Gather 32-bit words at 16-bit offsets and keep their low half, the entry itself.
+            words[j] = _mm256_and_si256(_mm256_i32gather_epi32(lut, index, 2), low);
+        }
+
+        // Packing works within 128-bit lanes, so restore the order of the quadwords afterwards.
+        const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(words[0], words[1]), 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(at + 2 * i), packed);
+    }
+#elif defined(__SSE2__) || defined(_M_X64)
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 scale = _mm_set1_ps(max_index);
+    const __m128 half = _mm_set1_ps(0.5f);
+
+    for (; i + 4 <= count; i += 4) {
+        __m128 x = _mm_loadu_ps(in + i);
+        x = _mm_max_ps(_mm_min_ps(x, one), zero);
+
+        alignas(16) std::int32_t index[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(index), _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(x, scale), half)));
+
+        // SSE2 has no gather, the lookups are scalar.
+        const std::uint16_t words[4] = {float_lut_[index[0]], float_lut_[index[1]], float_lut_[index[2]],
+                                        float_lut_[index[3]]};
+        std::memcpy(at + 2 * i, words, sizeof(words));
+    }
+#elif defined(__ARM_NEON)
+    const float32x4_t one = vdupq_n_f32(1.0f);
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    const float32x4_t half = vdupq_n_f32(0.5f);
+
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t x = vld1q_f32(in + i);
+
+        // A compare is false for NaN, which selects 1 as on x86.
+        x = vmaxq_f32(vbslq_f32(vcltq_f32(x, one), x, one), zero);
+
+        std::uint32_t index[4];
+        vst1q_u32(index, vcvtq_u32_f32(vmlaq_n_f32(half, x, max_index)));
+
+        // NEON has no gather, the lookups are scalar.
+        const std::uint16_t words[4] = {float_lut_[index[0]], float_lut_[index[1]], float_lut_[index[2]],
+                                        float_lut_[index[3]]};
+        std::memcpy(at + 2 * i, words, sizeof(words));
+    }
+#endif
+
+    for (; i < count; i++) {
+        const std::uint16_t word = float_lut_[QUANTIZE(in[i])];
+        std::memcpy(at + 2 * i, &word, sizeof(word));
+    }
+}
+
+void LEDriver::ColorTransform::transform(std::span<const std::uint8_t> rgb, std::span<std::byte> out) const {
+    if (rgb.size() % 3 != 0 || out.size() != rgb.size() * 2)
+        throw std::system_error(EINVAL, std::generic_category());
+
+    // One lookup per channel, the table already holds the swapped bytes. This does not gain from SIMD without
+    // gathers of 16-bit entries.
+    for (std::size_t i = 0; i < rgb.size(); i++) {
+        const std::uint16_t word = byte_lut_[rgb[i]];
+        std::memcpy(out.data() + 2 * i, &word, sizeof(word));
+    }
+}
+
+void LEDriver::ColorTransform::build_() noexcept {
+    const auto entry = [this](double input) {
+        const double output = std::pow(input, static_cast<double>(gamma_)) * brightness_ * 65535.0;
+        return TO_NET_ENDIAN(static_cast<std::uint16_t>(std::lround(output)));
+    };
+
+    for (std::size_t i = 0; i < float_steps; i++)
+        float_lut_[i] = entry(static_cast<double>(i) / (float_steps - 1));
+    float_lut_[float_steps] = 0;
+
+    for (std::size_t i = 0; i < byte_lut_.size(); i++)
+        byte_lut_[i] = entry(static_cast<double>(i) / 255.0);
+}
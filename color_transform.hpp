@@ -0,0 +1,90 @@
+/*!
+    \file
+    \brief Header containing `ColorTransform` class, converting batches of colors into net endian pixel payloads.
+    \copyright Copyright (c) 2026 Wiktor Sołtys
+    \cond
+        See LICENSE
+    \endcond
+*/
+#pragma once
+
+#include <array>
+#include <span>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace LEDriver {
+
+/*!
+    \brief Converts float or 8-bit RGB values into net endian u16 pixels in one pass, applying a gamma curve and
+           global dimming.
+
+    The output layout is the wire layout of `ColorState`: three u16 channels per pixel in net endian, 6 bytes in
+    total, as in UPDATE and UPDATE_PIXELS payloads. It can be sent as is with
+    `Controller::update_pixels(std::span<const std::byte>, std::uint16_t)`.
+
+    Gamma, dimming and byte order are folded into lookup tables built once per setting, so converting a channel is
+    one lookup. Float channels are clamped to [0, 1] and quantized to `ColorTransform::float_steps` steps with SSE2,
+    AVX2 (when built with `LEDRIVER_AVX2`) or NEON, with a scalar fallback. NaN maps to full brightness.
+*/
+class ColorTransform {
+  public:
+    //! Resolution of float channels: number of steps of the curve between 0 and 1.
+    static constexpr std::size_t float_steps = 4096;
+
+    //! Size of one output pixel in bytes.
+    static constexpr std::size_t pixel_size = 6;
+
+    /*!
+        Build the lookup tables.
+
+        \param gamma - exponent of the curve: output = input ^ gamma * brightness. 1 is linear.
+        \param brightness - global dimming factor, from 0 (off) to 1 (full).
+
+        \throw std::system_error
+               - `EINVAL` when `gamma` is not positive or `brightness` is outside [0, 1]
+    */
+    explicit ColorTransform(float gamma = 2.2f, float brightness = 1.0f);
+
+    /*!
+        \brief Change the global dimming factor, keeping the gamma curve.
+
+        \throw std::system_error
+               - `EINVAL` when `brightness` is outside [0, 1]
+    */
+    void set_brightness(float brightness);
+
+    //! \return Exponent of the curve.
+    float gamma() const noexcept;
+
+    //! \return Global dimming factor.
+    float brightness() const noexcept;
+
+    /*!
+        \brief Convert float RGB triples, with channels from 0 to 1.
+
+        \param rgb - interleaved channels: r, g, b of the first pixel, then of the next one.
+        \param out - `rgb.size() * 2` bytes of pixels.
+
+        \throw std::system_error
+               - `EINVAL` when `rgb` does not hold whole pixels or `out` is of different size
+    */
+    void transform(std::span<const float> rgb, std::span<std::byte> out) const;
+
+    //! \brief Convert 8-bit RGB triples. See `ColorTransform::transform()`.
+    void transform(std::span<const std::uint8_t> rgb, std::span<std::byte> out) const;
+
+  private:
+    float gamma_;
+    float brightness_;
+
+    // Output channels in net endian. The float table has one entry of padding, so SIMD gathers of 32-bit words at
+    // 16-bit offsets stay inside it.
+    alignas(64) std::array<std::uint16_t, float_steps + 1> float_lut_;
+    alignas(64) std::array<std::uint16_t, 256> byte_lut_;
+
+    void build_() noexcept;
+};
+
+} // namespace LEDriver
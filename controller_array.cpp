@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <span>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+
+#include <controller_array.hpp>
+#include <group.hpp>
+#include <ledriver.hpp>
+#include <tools.hpp>
+
+std::size_t LEDriver::ControllerArray::add(Controller&& ctl) {
+    if (!ctl.is_valid())
+        throw std::system_error(ENOTCONN, std::generic_category());
+
+    const std::uint64_t sent = ctl.color_state_cache_.load(std::memory_order_relaxed);
+
+    controllers_.push_back(std::move(ctl));
+    requested_.push_back(sent);
+    sent_.push_back(sent);
+
+    return controllers_.size() - 1;
+}
+
+void LEDriver::ControllerArray::reserve(std::size_t count) {
+    controllers_.reserve(count);
+    requested_.reserve(count);
+    sent_.reserve(count);
+}
+
+std::size_t LEDriver::ControllerArray::size() const noexcept {
+    return controllers_.size();
+}
+
+LEDriver::Controller& LEDriver::ControllerArray::operator[](std::size_t i) noexcept {
+    return controllers_[i];
+}
+
+const LEDriver::Controller& LEDriver::ControllerArray::operator[](std::size_t i) const noexcept {
+    return controllers_[i];
+}
+
+void LEDriver::ControllerArray::set(std::size_t i, const ColorState& state) noexcept {
+    requested_[i] = PACK_COLOR(state);
+}
+
+void LEDriver::ControllerArray::set(std::span<const ColorState> states) {
+    if (states.size() != controllers_.size())
+        throw std::system_error(EINVAL, std::generic_category());
+
+    for (std::size_t i = 0; i < states.size(); i++)
+        requested_[i] = PACK_COLOR(states[i]);
+}
+
+std::size_t LEDriver::ControllerArray::dirty() const noexcept {
+    std::size_t count{};
+    for (std::size_t i = 0; i < requested_.size(); i++)
+        count += requested_[i] != sent_[i];
+    return count;
+}
+
+std::size_t LEDriver::ControllerArray::flush() {
+    const std::size_t size = controllers_.size();
+    queued_.clear();
+
+    // Whole blocks are compared with branch-free XOR-OR reductions, only blocks with a change are walked.
+    std::size_t block{};
+    for (; block + block_size <= size; block += block_size) {
+        std::uint64_t changed{};
+        for (std::size_t i = block; i < block + block_size; i++)
+            changed |= requested_[i] ^ sent_[i];
+
+        if (changed == 0)
+            continue;
+
+        for (std::size_t i = block; i < block + block_size; i++)
+            if (requested_[i] != sent_[i])
+                queued_.push_back(i);
+    }
+    for (std::size_t i = block; i < size; i++)
+        if (requested_[i] != sent_[i])
+            queued_.push_back(i);
+
+    if (queued_.empty())
+        return 0;
+
+    // The group updates color caches of the controllers with sent frames, which are mirrored back.
+    const auto mirror = [this]() noexcept {
+        for (const std::size_t i : queued_)
+            sent_[i] = controllers_[i].color_state_cache_.load(std::memory_order_relaxed);
+    };
+
+    try {
+        // Closed controllers stay dirty instead of failing the whole batch.
+        for (const std::size_t i : queued_)
+            if (controllers_[i].is_valid())
+                group_.update(controllers_[i], UNPACK_COLOR(requested_[i]));
+
+        const std::size_t sent = group_.flush();
+        mirror();
+        return sent;
+    } catch (...) {
+        group_.clear();
+        mirror();
+        throw;
+    }
+}
@@ -0,0 +1,144 @@
+/*!
+    \file
+    \brief Header containing `ControllerArray` class, a fleet of controllers with flat color state for cheap
+           per-tick change detection.
+    \copyright Copyright (c) 2026 Wiktor Sołtys
+    \cond
+        See LICENSE
+    \endcond
+*/
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <group.hpp>
+#include <ledriver.hpp>
+
+namespace LEDriver {
+
+/*!
+    \brief A move-only fleet of controllers which keeps the requested and the sent color of every driver in two flat
+           arrays.
+
+    `ControllerArray::set()` only writes the requested color. `ControllerArray::flush()` compares both arrays, a
+    contiguous scan the compiler can vectorize, and sends UPDATE frames of changed drivers only, in one
+    `ControllerGroup` batch. Controllers themselves are touched for changed drivers only.
+
+    Colors of the controllers must be set through the array, other methods (e.g. `Controller::ping()`) may be called
+    directly through `ControllerArray::operator[]`.
+
+    The state of the fleet can be kept across restarts with `ControllerArray::save()` and `ControllerArray::restore()`.
+*/
+class ControllerArray {
+  public:
+    //! Create an empty array.
+    ControllerArray() noexcept = default;
+
+    ControllerArray(ControllerArray&&) noexcept = default;
+    ControllerArray& operator=(ControllerArray&&) noexcept = default;
+    ControllerArray(const ControllerArray&) = delete;
+    ControllerArray& operator=(const ControllerArray&) = delete;
+
+    /*!
+        \brief Take over a controller. Its last sent color becomes the requested one, so nothing is sent until it
+               changes.
+
+        \return Index of the controller.
+
+        \throw std::system_error
+               - `ENOTCONN` when Controller is not valid (closed)
+    */
+    std::size_t add(Controller&& ctl);
+
+    //! Reserve space for `count` controllers, so adding them does not reallocate.
+    void reserve(std::size_t count);
+
+    //! \return Number of controllers.
+    std::size_t size() const noexcept;
+
+    //! \return Controller at index `i`. Must be less than `ControllerArray::size()`.
+    Controller& operator[](std::size_t i) noexcept;
+
+    //! \return Controller at index `i`. Must be less than `ControllerArray::size()`.
+    const Controller& operator[](std::size_t i) const noexcept;
+
+    //! \brief Request the color of the controller at index `i`. Nothing is sent until `ControllerArray::flush()`.
+    void set(std::size_t i, const ColorState& state) noexcept;
+
+    /*!
+        \brief Request the colors of all controllers, in index order.
+
+        \throw std::system_error
+               - `EINVAL` when the number of states does not match `ControllerArray::size()`
+    */
+    void set(std::span<const ColorState> states);
+
+    //! \return Number of controllers whose requested color differs from the sent one.
+    std::size_t dirty() const noexcept;
+
+    /*!
+        \brief Send UPDATE frames to controllers whose requested color differs from the sent one.
+
+        \return Number of frames sent.
+
+        \throw std::system_error - as `ControllerGroup::flush()`. Frames not sent stay dirty.
+    */
+    std::size_t flush();
+
+    /*!
+        \brief Write a snapshot of all controllers to a file, replacing it atomically. See `ControllerArray::restore()`.
+
+        A snapshot is a 16-byte header followed by one 48-byte record per controller: the driver address, the last sent
+        color and the status cache with its age. Integers are in network endian, so snapshots are portable.
+
+        \param path - snapshot file.
+
+        \throw std::system_error
+               - `EIO` when the file could not be written
+               - system errors when the file could not be synced to the storage device
+               - errors of the file system (`std::filesystem::filesystem_error`)
+    */
+    void save(const std::filesystem::path& path) const;
+
+    /*!
+        \brief Add controllers from a snapshot written by `ControllerArray::save()` and push the restored scene.
+
+        The snapshot is memory-mapped and read in place. Every record becomes a new controller with its status cache
+        (color and power, see `Controller::cached_status()`) seeded as old as it was when saved. Restored colors are
+        then sent with one `ControllerArray::flush()`, so from then on the color caches dedupe as before the restart.
+        Power is restored into the status cache only and sent by the next `Controller::power()`, whatever its state.
+
+        \param path - snapshot file.
+        \param timeout - reply timeout of the restored controllers. See `Controller::Controller()`.
+
+        \return Number of controllers added.
+
+        \throw std::system_error
+               - `EINVAL` when the file is not a valid snapshot
+               - errors of the file system and of socket creation, when nothing has been added
+               - as `ControllerArray::flush()`, when the controllers have been added but not all colors were sent
+    */
+    std::size_t restore(const std::filesystem::path& path,
+                        std::chrono::milliseconds timeout = std::chrono::milliseconds(1000));
+
+  private:
+    //! Number of colors compared at once before looking at single ones.
+    static constexpr std::size_t block_size = 8;
+
+    std::vector<Controller> controllers_;
+
+    // Packed with `PACK_COLOR()`. `sent_` mirrors the color cache of each controller.
+    std::vector<std::uint64_t> requested_;
+    std::vector<std::uint64_t> sent_;
+
+    ControllerGroup group_;
+    std::vector<std::size_t> queued_;
+};
+
+} // namespace LEDriver
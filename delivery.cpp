@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <system_error>
+#include <utility>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+
+#include <event_loop.hpp>
+#include <ledriver.hpp>
+#include <metrics.hpp>
+#include <tools.hpp>
+
+namespace {
+
+template <typename T> void invalidate(std::atomic<T>& cache, T sent, T unknown) noexcept {
+    cache.compare_exchange_strong(sent, unknown, std::memory_order_acq_rel, std::memory_order_relaxed);
+}
+
+// Encode a change of the color, the power or both: UPDATE, POWER or SET_STATE. Returns the size of the frame.
+template <std::size_t N>
+std::size_t encode_change(bool color, bool power, std::uint16_t flags, const LEDriver::Status& state,
+                          std::array<std::byte, N>& frame) noexcept {
+    const auto store = [&frame](const auto& encoded) {
+        static_assert(sizeof(encoded) <= N);
+        std::memcpy(frame.data(), encoded.data(), encoded.size());
+        return encoded.size();
+    };
+
+    if (color && power)
+        return store(SetStateFrame::encode(flags, state.color, state.power));
+    if (color)
+        return store(UpdateFrame::encode(flags, state.color));
+    return store(PowerFrame::encode(flags, state.power));
+}
+
+} // namespace
+
+void LEDriver::EventLoop::update(Controller& ctl, const ColorState& state, AckCallback callback) {
+    deliver_(ctl, field_color, {state, false}, std::move(callback));
+}
+
+void LEDriver::EventLoop::power(Controller& ctl, bool state, AckCallback callback) {
+    deliver_(ctl, field_power, {{}, state}, std::move(callback));
+}
+
+void LEDriver::EventLoop::set_state(Controller& ctl, const Status& state, AckCallback callback) {
+    deliver_(ctl, field_color | field_power, state, std::move(callback));
+}
+
+void LEDriver::EventLoop::deliver_(Controller& ctl, std::uint8_t fields, const Status& state, AckCallback callback) {
+    if (!ctl.is_valid())
+        throw std::system_error(ENOTCONN, std::generic_category());
+
+    if (deliveries_ >= window_)
+        throw std::system_error(EBUSY, std::generic_category());
+
+    const Key key{ctl.fd_, ctl.addr_, ctl.next_sequence_()};
+    if (requests_.contains(key))
+        throw std::system_error(EBUSY, std::generic_category());
+
+    // Keep the encoded frame, so retransmissions are sent from it as they are.
+    const auto flags = static_cast<std::uint16_t>(key.sequence | RootHeader::flag_ack);
+    std::array<std::byte, sizeof(RootHeader) + 8> frame{};
+    const std::size_t frame_size = encode_change(fields & field_color, fields & field_power, flags, state, frame);
+
+    // Send and claim under the state lock, so concurrent plain updates reach the driver in the order of the caches.
+    std::unique_lock lock(ctl.state_mutex_);
+    ctl.send_({std::span<const std::byte>(frame.data(), frame_size)});
+
+    // Older in-flight changes of the same fields must not revert this one.
+    Owners& owners = owners_[&ctl];
+    if ((fields & field_color) && owners.color)
+        supersede_(*owners.color, owners, field_color);
+    if ((fields & field_power) && owners.power)
+        supersede_(*owners.power, owners, field_power);
+
+    // Claim the caches, so plain updates of the same state are deduplicated while this one is in flight.
+    if (fields & field_color) {
+        ctl.color_state_cache_.store(PACK_COLOR(state.color), std::memory_order_release);
+        owners.color = key;
+    }
+    if (fields & field_power) {
+        ctl.power_state_cache_.store(state.power ? 0x01 : 0x00, std::memory_order_release);
+        owners.power = key;
+    }
+
+    lock.unlock();
+
+    watch_(key.fd, ctl.shared_.get());
+
+    const auto now = clock::now();
+    Request& request = requests_[key];
+    request.id = next_id_++;
+    request.ctl = &ctl;
+    std::memcpy(&request.header, frame.data(), sizeof(request.header));
+    request.sent = now;
+    request.metrics = ctl.metrics_.load(std::memory_order_acquire);
+    request.on_ack = std::move(callback);
+    request.fields = fields;
+    request.color = PACK_COLOR(state.color);
+    request.power = state.power;
+    request.retransmits_left = attempts_ - 1;
+    request.frame = frame;
+    request.frame_size = frame_size;
+
+    deliveries_++;
+    timers_.push({now + retransmit_interval_, request.id, key});
+}
+
+void LEDriver::EventLoop::supersede_(const Key& key, Owners& owners, std::uint8_t field) {
+    (field == field_color ? owners.color : owners.power).reset();
+
+    const auto it = requests_.find(key);
+    if (it == requests_.end())
+        return;
+
+    Request& request = it->second;
+    const bool owns_color = owners.color && KeyEqual()(*owners.color, key);
+    const bool owns_power = owners.power && KeyEqual()(*owners.power, key);
+
+    // Nothing left to deliver: let it expire without retransmitting.
+    if (!owns_color && !owns_power) {
+        request.retransmits_left = 0;
+        return;
+    }
+
+    // Retransmit only the fields it still owns, under the same sequence number, so its acknowledgement still matches.
+    const auto flags = DESERIALIZE_U16(request.header.flags);
+    request.frame_size = encode_change(owns_color, owns_power, flags, {UNPACK_COLOR(request.color), request.power},
+                                       request.frame);
+    std::memcpy(&request.header, request.frame.data(), sizeof(request.header));
+}
+
+bool LEDriver::EventLoop::retransmit_(const Key& key, Request& request, clock::time_point now) {
+    request.retransmits_left--;
+
+    try {
+        request.ctl->send_({std::span<const std::byte>(request.frame.data(), request.frame_size)});
+    } catch (const std::system_error&) {
+        complete_(key, {}, now);
+        return false;
+    }
+
+    if (request.metrics)
+        request.metrics->retransmits_.fetch_add(1, std::memory_order_relaxed);
+
+    timers_.push({now + retransmit_interval_, request.id, key});
+    return true;
+}
+
+void LEDriver::EventLoop::release_(const Key& key, const Request& request, bool acked) noexcept {
+    deliveries_--;
+
+    if (!acked && request.metrics)
+        request.metrics->undelivered_.fetch_add(1, std::memory_order_relaxed);
+
+    const auto it = owners_.find(request.ctl);
+    if (it == owners_.end())
+        return;
+
+    // Only the newest change of a field updates its caches. A failed one leaves the driver state unknown, so the
+    // next plain update is sent regardless of deduplication, unless a plain update has already replaced it.
+    Controller& ctl = *request.ctl;
+    Owners& owners = it->second;
+    const std::lock_guard lock(ctl.state_mutex_);
+
+    if (owners.color && KeyEqual()(*owners.color, key)) {
+        owners.color.reset();
+        if (acked)
+            ctl.cache_status_(request.color | Controller::status_color_known,
+                              Controller::status_color_mask | Controller::status_color_known);
+        else
+            invalidate(ctl.color_state_cache_, request.color, Controller::color_unknown);
+    }
+
+    if (owners.power && KeyEqual()(*owners.power, key)) {
+        owners.power.reset();
+        if (acked)
+            ctl.cache_status_(request.power ? Controller::status_power_bit | Controller::status_power_known
+                                            : Controller::status_power_known,
+                              Controller::status_power_bit | Controller::status_power_known);
+        else
+            invalidate(ctl.power_state_cache_, std::uint8_t(request.power ? 0x01 : 0x00), Controller::power_unknown);
+    }
+
+    if (!owners.color && !owners.power)
+        owners_.erase(it);
+}
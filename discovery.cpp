@@ -0,0 +1,160 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <system_error>
+#include <vector>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+
+#if defined(_WIN32)
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+
+    #pragma comment(lib, "Ws2_32.lib")
+#else
+    #include <netinet/in.h>
+    #include <poll.h>
+    #include <sys/socket.h>
+    #include <unistd.h>
+#endif
+
+#include <discovery.hpp>
+#include <ledriver.hpp>
+#include <tools.hpp>
+
+namespace {
+
+#if defined(_WIN32)
+using socket_t = SOCKET;
+constexpr socket_t invalid_socket = INVALID_SOCKET;
+#else
+using socket_t = int;
+constexpr socket_t invalid_socket = -1;
+#endif
+
+//! Requested receive buffer size in bytes, so a burst of PONG frames from a large fleet is not dropped.
+constexpr int receive_buffer_size = 4 << 20;
+
+//! Closes the socket on every exit path.
+struct SocketCloser {
+    socket_t fd;
+
+    ~SocketCloser() noexcept {
+#if defined(_WIN32)
+        ::closesocket(fd);
+#else
+        ::close(fd);
+#endif
+    }
+};
+
+/*!
+    \return `true` when `code` of a failed receive says nothing about the socket: an ICMP error of an earlier datagram,
+            an interrupted call or, on Windows, a datagram larger than the buffer (it is dropped, like a truncated one
+            elsewhere).
+*/
+bool IS_SKIPPABLE(int code) noexcept {
+#if defined(_WIN32)
+    return code == WSAECONNRESET || code == WSAEINTR || code == WSAEMSGSIZE;
+#else
+    return code == ECONNREFUSED || code == EINTR;
+#endif
+}
+
+} // namespace
+
+std::vector<sockaddr_storage> LEDriver::discover(const sockaddr_storage& target, std::chrono::milliseconds window) {
+
+    // Support only IP4 and IP6.
+    if (target.ss_family != AF_INET && target.ss_family != AF_INET6)
+        throw std::system_error(EINVAL, std::generic_category());
+
+    // If windows, initialize winsock.
+    INIT_SOCKETS();
+
+    // Create UDP socket. It stays unconnected, replies come from every driver's own address.
+    const socket_t fd = ::socket(target.ss_family, SOCK_DGRAM, 0);
+    if (fd == invalid_socket)
+        throw std::system_error(GET_SOCKET_ERROR(), std::system_category(), "socket");
+    const SocketCloser closer{fd};
+
+    if (target.ss_family == AF_INET) {
+        const int enable = 1;
+        if (::setsockopt(fd, SOL_SOCKET, SO_BROADCAST, reinterpret_cast<const char*>(&enable), sizeof(enable)) != 0)
+            throw std::system_error(GET_SOCKET_ERROR(), std::system_category(), "setsockopt");
+    } else {
+        // Link-local multicast needs the interface to send on, taken from the scope of the address.
+        const auto& in6 = reinterpret_cast<const sockaddr_in6&>(target);
+        const unsigned int index = in6.sin6_scope_id;
+        if (index != 0 && ::setsockopt(fd, IPPROTO_IPV6, IPV6_MULTICAST_IF, reinterpret_cast<const char*>(&index),
+                                       sizeof(index)) != 0)
+            throw std::system_error(GET_SOCKET_ERROR(), std::system_category(), "setsockopt");
+    }
+
+    // Best effort, the system may cap the size.
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVBUF, reinterpret_cast<const char*>(&receive_buffer_size),
+                 sizeof(receive_buffer_size));
+
+    // The socket is used for this PING only, so any sequence number tells the PONG frames apart from strays.
+    const RootHeader ping = MAKE_HEADER(Action::PING, 1);
+
+#if defined(_WIN32)
+    const int sent = ::sendto(fd, reinterpret_cast<const CHAR*>(&ping), sizeof(ping), 0,
+                              reinterpret_cast<const sockaddr*>(&target), SOCKADDR_LEN(target));
+    if (sent == SOCKET_ERROR)
+        throw std::system_error(GET_SOCKET_ERROR(), std::system_category(), "sendto");
+#else
+    const ssize_t sent = ::sendto(fd, &ping, sizeof(ping), 0, reinterpret_cast<const sockaddr*>(&target),
+                                  SOCKADDR_LEN(target));
+    if (sent < 0)
+        throw std::system_error(GET_SOCKET_ERROR(), std::system_category(), "sendto");
+#endif
+
+    std::vector<sockaddr_storage> found;
+    const auto deadline = std::chrono::steady_clock::now() + window;
+
+    while (true) {
+        // `WAIT_READABLE()` treats zero as no time limit, so an expired window ends here.
+        const auto left = std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        if (left.count() <= 0 || !WAIT_READABLE(fd, left))
+            break;
+
+        // Larger datagrams are truncated and fail the size check, or fail the receive on Windows.
+        std::array<std::byte, sizeof(RootHeader) + 1> reply;
+        sockaddr_storage from{};
+        socklen_t from_len = sizeof(from);
+
+#if defined(_WIN32)
+        const int received = ::recvfrom(fd, reinterpret_cast<CHAR*>(reply.data()), static_cast<int>(reply.size()), 0,
+                                        reinterpret_cast<sockaddr*>(&from), &from_len);
+        if (received == SOCKET_ERROR) {
+#else
+        const ssize_t received =
+            ::recvfrom(fd, reply.data(), reply.size(), 0, reinterpret_cast<sockaddr*>(&from), &from_len);
+        if (received < 0) {
+#endif
+            const int code = GET_SOCKET_ERROR();
+            if (IS_SKIPPABLE(code))
+                continue;
+            throw std::system_error(code, std::system_category(), "recvfrom");
+        }
+
+        if (static_cast<std::size_t>(received) != sizeof(RootHeader))
+            continue;
+
+        RootHeader pong;
+        std::memcpy(&pong, reply.data(), sizeof(pong));
+        if (!IS_PONG(ping, pong))
+            continue;
+
+        const bool known = std::any_of(found.begin(), found.end(), [&](const sockaddr_storage& addr) {
+            return SOCKADDR_COMPARE(addr, from) == 0;
+        });
+        if (!known)
+            found.push_back(from);
+    }
+
+    return found;
+}
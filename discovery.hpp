@@ -0,0 +1,43 @@
+/*!
+    \file
+    \brief Header containing `discover()`, locating drivers with a single broadcast or multicast PING.
+    \copyright Copyright (c) 2026 Wiktor Sołtys
+    \cond
+        See LICENSE
+    \endcond
+*/
+#pragma once
+
+#include <chrono>
+#include <vector>
+
+#if defined(_WIN32)
+    #include <winsock2.h>
+#else
+    #include <sys/socket.h>
+#endif
+
+namespace LEDriver {
+
+/*!
+    \brief Send one PING frame to a broadcast (IP4) or multicast (IP6) address and collect the drivers which answer.
+
+    Every driver listening on the address answers with a PONG from its own unicast address, so the whole fleet is
+    found in about one round trip. Returned addresses can be passed directly to the `Controller` constructors. A
+    unicast address works as well and finds at most one driver.
+
+    UDP gives no delivery guarantee: on a lossy network call it again and merge the results.
+
+    \param target - IP4 broadcast address (e.g. `255.255.255.255` or a subnet broadcast) or IP6 multicast address
+                    (e.g. `ff02::1`, with `sin6_scope_id` set to the interface index), with the driver port.
+    \param window - time to collect PONG frames for.
+
+    \return Addresses of the drivers which answered, in order of arrival and without duplicates.
+
+    \throw std::system_error
+           - `EINVAL` when the address family is neither IP4 nor IP6
+           - system network layer errors
+*/
+std::vector<sockaddr_storage> discover(const sockaddr_storage& target, std::chrono::milliseconds window);
+
+} // namespace LEDriver
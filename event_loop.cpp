@@ -0,0 +1,478 @@
+#include <algorithm>
+#include <chrono>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+
+#if defined(_WIN32)
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+
+    #pragma comment(lib, "Ws2_32.lib")
+#else
+    #include <poll.h>
+    #include <sys/socket.h>
+    #include <sys/uio.h>
+    #include <unistd.h>
+#endif
+
+#if defined(__linux__)
+    #include <sys/epoll.h>
+#endif
+
+#include <event_loop.hpp>
+#include <ledriver.hpp>
+#include <metrics.hpp>
+#include <shared_socket.hpp>
+#include <tools.hpp>
+
+std::size_t LEDriver::EventLoop::KeyHash::operator()(const Key& key) const noexcept {
+    // Mix in 64 bits and fold down, so the hash is well defined with a 32-bit `std::size_t` too.
+    const std::uint64_t hash = SOCKADDR_HASH(key.addr) ^ (static_cast<std::uint64_t>(key.fd) * 0x9E3779B97F4A7C15ull) ^
+                               (static_cast<std::uint64_t>(key.sequence) << 48);
+    if constexpr (sizeof(std::size_t) < sizeof(std::uint64_t))
+        return static_cast<std::size_t>(hash ^ (hash >> 32));
+    else
+        return static_cast<std::size_t>(hash);
+}
+
+bool LEDriver::EventLoop::KeyEqual::operator()(const Key& a, const Key& b) const noexcept {
+    return a.fd == b.fd && a.sequence == b.sequence && SOCKADDR_COMPARE(a.addr, b.addr) == 0;
+}
+
+LEDriver::EventLoop::EventLoop(std::chrono::milliseconds retransmit_interval, std::size_t attempts, std::size_t window)
+    : ring_(batch_size * max_datagram_size), sources_(batch_size), retransmit_interval_(retransmit_interval),
+      attempts_(attempts), window_(window) {
+    if (retransmit_interval.count() <= 0 || attempts == 0 || window == 0)
+        throw std::system_error(EINVAL, std::generic_category());
+
+#if defined(__linux__)
+    epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ < 0)
+        throw std::system_error(errno, std::system_category(), "epoll_create1");
+#endif
+}
+
+LEDriver::EventLoop::~EventLoop() noexcept {
+#if defined(__linux__)
+    ::close(epoll_fd_);
+#endif
+}
+
+void LEDriver::EventLoop::ping(Controller& ctl, PingCallback callback) {
+    submit_(ctl, Action::PING).on_pong = std::move(callback);
+}
+
+void LEDriver::EventLoop::status(Controller& ctl, StatusCallback callback) {
+    submit_(ctl, Action::STATUS).on_status = std::move(callback);
+}
+
+void LEDriver::EventLoop::cancel(const Controller& ctl) noexcept {
+
+    // Timers of cancelled requests are skipped when they expire. Cancelled state changes may never have been applied,
+    // so their caches are invalidated as for failed ones.
+    for (auto it = requests_.begin(); it != requests_.end();) {
+        if (it->first.fd == ctl.fd_ && SOCKADDR_COMPARE(it->first.addr, ctl.addr_) == 0) {
+            if (it->second.fields != 0)
+                release_(it->first, it->second, false);
+            it = requests_.erase(it);
+            unwatch_(ctl.fd_);
+        } else {
+            it++;
+        }
+    }
+
+    owners_.erase(&ctl);
+}
+
+std::size_t LEDriver::EventLoop::run_once(std::chrono::milliseconds max_wait) {
+    std::size_t completed{};
+
+    while (!requests_.empty()) {
+        auto now = clock::now();
+
+        // Drop timers of requests which have already completed.
+        while (!timers_.empty()) {
+            const auto it = requests_.find(timers_.top().key);
+            if (it != requests_.end() && it->second.id == timers_.top().id)
+                break;
+            timers_.pop();
+        }
+
+        // Wait no longer than until the nearest timeout.
+        std::chrono::milliseconds wait = max_wait;
+        if (!timers_.empty()) {
+            const auto until = std::chrono::ceil<std::chrono::milliseconds>(timers_.top().deadline - now);
+            const auto until_ms = std::max(until, std::chrono::milliseconds(0));
+            wait = wait.count() < 0 ? until_ms : std::min(wait, until_ms);
+        }
+
+        // Replies read by other readers of a shared socket do not wake the loop, their mailboxes are polled instead.
+        if (shared_watched_ != 0)
+            wait = wait.count() < 0 ? shared_poll_interval : std::min(wait, shared_poll_interval);
+
+        const int wait_ms = wait.count() < 0 ? -1 : static_cast<int>(std::min<long long>(wait.count(), INT32_MAX));
+
+#if defined(__linux__)
+        epoll_event events[64];
+        int ready = ::epoll_wait(epoll_fd_, events, 64, wait_ms);
+        if (ready < 0 && errno != EINTR)
+            throw std::system_error(errno, std::system_category(), "epoll_wait");
+
+        now = clock::now();
+        for (int i = 0; i < ready; i++)
+            completed += drain_(events[i].data.fd, now);
+#else
+    #if defined(_WIN32)
+        std::vector<WSAPOLLFD> fds;
+    #else
+        std::vector<pollfd> fds;
+    #endif
+        fds.reserve(watched_.size());
+        for (const auto& [fd, watch] : watched_) {
+            auto& pfd = fds.emplace_back();
+            pfd.fd = fd;
+            pfd.events = POLLIN;
+        }
+
+    #if defined(_WIN32)
+        const int ready = ::WSAPoll(fds.data(), static_cast<ULONG>(fds.size()), wait_ms);
+        if (ready == SOCKET_ERROR)
+            throw std::system_error(GET_SOCKET_ERROR(), std::system_category(), "WSAPoll");
+    #else
+        const int ready = ::poll(fds.data(), static_cast<nfds_t>(fds.size()), wait_ms);
+        if (ready < 0 && errno != EINTR)
+            throw std::system_error(errno, std::system_category(), "poll");
+    #endif
+
+        now = clock::now();
+        for (std::size_t i = 0; ready > 0 && i < fds.size(); i++)
+            if (fds[i].revents != 0)
+                completed += drain_(fds[i].fd, now);
+#endif
+
+        if (shared_watched_ != 0)
+            completed += collect_();
+
+        // Complete requests whose timeout expired.
+        now = clock::now();
+        while (!timers_.empty() && timers_.top().deadline <= now) {
+            const Timer timer = timers_.top();
+            timers_.pop();
+
+            const auto it = requests_.find(timer.key);
+            if (it == requests_.end() || it->second.id != timer.id)
+                continue;
+
+            // State changes are retransmitted until they run out of attempts or get superseded.
+            if (it->second.fields != 0 && it->second.retransmits_left > 0) {
+                if (!retransmit_(timer.key, it->second, now))
+                    completed++;
+                continue;
+            }
+
+            if (it->second.fields == 0)
+                it->second.ctl->rtt_timeout_();
+            if (it->second.metrics)
+                it->second.metrics->timeouts_.fetch_add(1, std::memory_order_relaxed);
+
+            complete_(timer.key, {}, now);
+            completed++;
+        }
+
+        // A negative wait means: until at least one request completes.
+        if (completed != 0 || max_wait.count() >= 0)
+            break;
+    }
+
+    return completed;
+}
+
+void LEDriver::EventLoop::run() {
+    while (!requests_.empty())
+        run_once();
+}
+
+std::size_t LEDriver::EventLoop::pending() const noexcept {
+    return requests_.size();
+}
+
+LEDriver::EventLoop::Request& LEDriver::EventLoop::submit_(Controller& ctl, Action action) {
+    if (!ctl.is_valid())
+        throw std::system_error(ENOTCONN, std::generic_category());
+
+    const Key key{ctl.fd_, ctl.addr_, ctl.next_sequence_()};
+    if (requests_.contains(key))
+        throw std::system_error(EBUSY, std::generic_category());
+
+    const RootHeader header = MAKE_HEADER(action, key.sequence);
+    ctl.send_({TO_CIOV(header)});
+
+    watch_(key.fd, ctl.shared_.get());
+
+    const auto now = clock::now();
+    Request& request = requests_[key];
+    request.id = next_id_++;
+    request.ctl = &ctl;
+    request.header = header;
+    request.sent = now;
+    request.metrics = ctl.metrics_.load(std::memory_order_acquire);
+
+    if (const auto timeout = ctl.reply_timeout(); timeout.count() > 0)
+        timers_.push({now + timeout, request.id, key});
+
+    return request;
+}
+
+void LEDriver::EventLoop::complete_(const Key& key, std::span<const std::byte> reply, clock::time_point now) {
+    const auto it = requests_.find(key);
+    if (it == requests_.end())
+        return;
+
+    // Remove the request before invoking the callback, so the callback can submit a new one.
+    Request request = std::move(it->second);
+    requests_.erase(it);
+    unwatch_(key.fd);
+
+    const auto rtt = now - request.sent;
+    const Action action = DESERIALIZE_ACTION(request.header.action);
+
+    // Check the reply against the request: an acknowledgement, a PONG or a STATUS reply. An empty reply stands for a
+    // timeout or a network error.
+    bool valid = false;
+    if (request.fields != 0) {
+        valid = reply.size() == sizeof(RootHeader);
+    } else if (action == Action::STATUS) {
+        valid = StatusReplyFrame::is_reply(reply, request.header);
+    } else if (reply.size() == sizeof(RootHeader)) {
+        RootHeader pong_header;
+        std::memcpy(&pong_header, reply.data(), sizeof(pong_header));
+        valid = IS_PONG(request.header, pong_header);
+    }
+
+    // Only valid replies are timed.
+    if (request.metrics && !reply.empty()) {
+        const std::size_t expected = action == Action::STATUS ? StatusReplyFrame::size : PingFrame::size;
+        if (valid)
+            request.metrics->rtt_(action, rtt);
+        else if (reply.size() != expected)
+            request.metrics->short_replies_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if (request.fields != 0) {
+        release_(key, request, valid);
+        if (request.on_ack)
+            request.on_ack(valid, rtt);
+    } else if (request.on_pong) {
+        if (valid)
+            request.ctl->rtt_sample_(rtt);
+        request.on_pong(valid, rtt);
+    } else if (request.on_status) {
+        std::optional<Status> status;
+        if (valid) {
+            status = PARSE_STATUS(reply.first<StatusReplyFrame::size>());
+            request.ctl->cache_status_(*status);
+            request.ctl->rtt_sample_(rtt);
+        }
+        request.on_status(status, rtt);
+    }
+}
+
+std::size_t LEDriver::EventLoop::drain_(socket_t fd, clock::time_point& now) {
+    std::size_t completed{};
+
+    // The socket may have been unwatched by callbacks of earlier replies.
+    for (auto watch = watched_.find(fd); watch != watched_.end(); watch = watched_.find(fd)) {
+
+        // A shared socket is read by one thread at a time. While another one reads, it routes replies of the loop to
+        // their mailboxes, see `EventLoop::collect_()`.
+        SharedSocket* const shared = watch->second.shared;
+        if (shared && !shared->begin_drain_())
+            break;
+
+        // Read up to `batch_size` datagrams into the receive ring, with a single system call where available.
+        std::size_t sizes[batch_size];
+        std::size_t received{};
+        bool failed{};
+        bool empty{};
+
+#if defined(__linux__)
+        mmsghdr messages[batch_size]{};
+        iovec segments[batch_size]{};
+
+        for (std::size_t i = 0; i < batch_size; i++) {
+            segments[i] = {ring_.data() + i * max_datagram_size, max_datagram_size};
+            messages[i].msg_hdr.msg_name = &sources_[i];
+            messages[i].msg_hdr.msg_namelen = sizeof(sources_[i]);
+            messages[i].msg_hdr.msg_iov = &segments[i];
+            messages[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        const int result = ::recvmmsg(fd, messages, batch_size, MSG_DONTWAIT, nullptr);
+        if (result < 0) {
+            failed = true;
+            empty = errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        } else {
+            received = static_cast<std::size_t>(result);
+            for (std::size_t i = 0; i < received; i++)
+                sizes[i] = messages[i].msg_len;
+        }
+#elif defined(_WIN32)
+        // Winsock sockets are blocking, so read one datagram per readiness notification.
+        socklen_t source_len = sizeof(sources_[0]);
+        const int result = ::recvfrom(fd, reinterpret_cast<CHAR*>(ring_.data()), static_cast<int>(max_datagram_size),
+                                      0, reinterpret_cast<sockaddr*>(&sources_[0]), &source_len);
+        if (result == SOCKET_ERROR) {
+            failed = true;
+            empty = GET_SOCKET_ERROR() == WSAEWOULDBLOCK;
+        } else {
+            sizes[received++] = static_cast<std::size_t>(result);
+        }
+#else
+        while (received < batch_size) {
+            socklen_t source_len = sizeof(sources_[received]);
+            const ssize_t result = ::recvfrom(fd, ring_.data() + received * max_datagram_size, max_datagram_size,
+                                              MSG_DONTWAIT, reinterpret_cast<sockaddr*>(&sources_[received]),
+                                              &source_len);
+            if (result < 0) {
+                failed = true;
+                empty = errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+                break;
+            }
+
+            sizes[received++] = static_cast<std::size_t>(result);
+        }
+#endif
+
+        // Hand the datagrams of other controllers on a shared socket over to them, before any callback runs.
+        std::optional<Key> keys[batch_size];
+        for (std::size_t i = 0; i < received; i++)
+            keys[i] = match_(fd, sources_[i], {ring_.data() + i * max_datagram_size, sizes[i]});
+
+        if (shared) {
+            try {
+                for (std::size_t i = 0; i < received; i++)
+                    if (!keys[i])
+                        shared->route_(sources_[i], {ring_.data() + i * max_datagram_size, sizes[i]}, now);
+            } catch (...) {
+                shared->end_drain_();
+                throw;
+            }
+            shared->end_drain_();
+        }
+
+        // Datagrams too short to carry a header and stale replies are dropped.
+        for (std::size_t i = 0; i < received && watched_.contains(fd); i++) {
+            if (keys[i]) {
+                complete_(*keys[i], {ring_.data() + i * max_datagram_size, sizes[i]}, now);
+                completed++;
+            }
+        }
+
+        // A network error (e.g. ICMP port unreachable on a connected socket) fails every request on the socket.
+        if (failed && !empty) {
+            std::vector<Key> failed_keys;
+            for (const auto& [pending_key, request] : requests_)
+                if (pending_key.fd == fd)
+                    failed_keys.push_back(pending_key);
+
+            for (const Key& failed_key : failed_keys) {
+                complete_(failed_key, {}, now);
+                completed++;
+            }
+            break;
+        }
+
+        // A short batch means the socket is empty.
+        if (failed || received < batch_size)
+            break;
+    }
+
+    return completed;
+}
+
+std::size_t LEDriver::EventLoop::collect_() {
+    std::vector<std::pair<Key, SharedSocket::Datagram>> replies;
+    std::vector<std::pair<sockaddr_storage, SharedSocket::Datagram>> routed;
+
+    for (auto& [fd, watch] : watched_) {
+        if (!watch.shared)
+            continue;
+
+        const socket_t socket = fd;
+        watch.shared->collect_(
+            watch.routed,
+            [this, socket](const sockaddr_storage& source, std::span<const std::byte> datagram) {
+                return match_(socket, source, datagram).has_value();
+            },
+            routed);
+
+        for (auto& [source, datagram] : routed)
+            replies.emplace_back(*match_(socket, source, datagram.data), std::move(datagram));
+        routed.clear();
+    }
+
+    // Complete only after collecting, as callbacks may unwatch sockets. The round trip ends when the reply was read.
+    for (auto& [key, datagram] : replies)
+        complete_(key, datagram.data, datagram.arrival);
+
+    return replies.size();
+}
+
+std::optional<LEDriver::EventLoop::Key> LEDriver::EventLoop::match_(socket_t fd, const sockaddr_storage& source,
+                                                                   std::span<const std::byte> datagram) const {
+    if (datagram.size() < sizeof(RootHeader))
+        return std::nullopt;
+
+    RootHeader header;
+    std::memcpy(&header, datagram.data(), sizeof(header));
+
+    Key key{fd, source, 0};
+    key.sequence = DESERIALIZE_U16(header.flags) & RootHeader::sequence_mask;
+
+    const auto it = requests_.find(key);
+    if (it == requests_.end() || it->second.header.action != header.action)
+        return std::nullopt;
+
+    return key;
+}
+
+void LEDriver::EventLoop::watch_(socket_t fd, SharedSocket* shared) {
+    Watch& watch = watched_[fd];
+    if (watch.requests++ != 0)
+        return;
+
+    watch.shared = shared;
+    watch.routed = 0;
+
+#if defined(__linux__)
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) != 0) {
+        watched_.erase(fd);
+        throw std::system_error(errno, std::system_category(), "epoll_ctl");
+    }
+#endif
+
+    if (shared)
+        shared_watched_++;
+}
+
+void LEDriver::EventLoop::unwatch_(socket_t fd) noexcept {
+    const auto it = watched_.find(fd);
+    if (it == watched_.end() || --it->second.requests != 0)
+        return;
+
+    if (it->second.shared)
+        shared_watched_--;
+    watched_.erase(it);
+
+#if defined(__linux__)
+    ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+#endif
+}
@@ -0,0 +1,271 @@
+/*!
+    \file
+    \brief Header containing `EventLoop` class, used for asynchronous requests to many drivers.
+    \copyright Copyright (c) 2026 Wiktor Sołtys
+    \cond
+        See LICENSE
+    \endcond
+*/
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <functional>
+#include <optional>
+#include <queue>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <ledriver.hpp>
+
+namespace LEDriver {
+
+/*!
+    \brief Single-threaded event loop keeping many PING/STATUS requests in flight at once.
+
+    Requests are sent immediately and complete from `EventLoop::run_once()` / `EventLoop::run()` as replies arrive
+    or when the reply timeout of the controller (see `Controller::reply_timeout()`) expires. Readiness is watched with
+    `epoll` on Linux and `poll()`/`WSAPoll()` elsewhere. Replies are drained up to 64 per `recvmmsg()` call on Linux.
+
+    Any number of requests per controller may be pending, replies are told apart by their sequence number (see
+    `RootHeader::sequence_mask`). A controller must outlive its pending requests (see `EventLoop::cancel()`) and must
+    not be used for blocking `Controller::ping()`/`Controller::status()` calls while it has pending requests, as
+    those would read each other's replies. Other controllers on a `SharedSocket` may: the loop routes their replies to
+    them, and picks up its own replies read by their calls within `shared_poll_interval`.
+
+    State changes sent with `EventLoop::update()`, `EventLoop::power()` and `EventLoop::set_state()` are acknowledged
+    by the driver (see `RootHeader::flag_ack`) and retransmitted on a timer until they are, without blocking on any
+    single frame. A newer state change supersedes the fields it sets (color, power) in older in-flight ones of the
+    same controller, so a late retransmit can not revert newer state: an older change is retransmitted with the fields
+    it still owns only, and no longer at all once all of them are superseded.
+*/
+class EventLoop {
+  public:
+    /*!
+        Called when a PING request completes.
+
+        \param pong - `true` when the driver returned correct PONG frame, `false` on timeout or network error.
+        \param rtt - round trip time, or time waited when there was no reply.
+    */
+    using PingCallback = std::function<void(bool pong, std::chrono::nanoseconds rtt)>;
+
+    /*!
+        Called when a STATUS request completes.
+
+        \param status - driver status, empty on timeout, network error or invalid reply.
+        \param rtt - round trip time, or time waited when there was no reply.
+    */
+    using StatusCallback = std::function<void(std::optional<Status> status, std::chrono::nanoseconds rtt)>;
+
+    /*!
+        Called when an acknowledged state change completes.
+
+        \param acked - `true` when the driver acknowledged the frame, `false` when all attempts were unanswered, on
+                       network error, or when newer state changes superseded all fields of this one before it was
+                       acknowledged.
+        \param rtt - time from the first transmission to the acknowledgement, or time waited when there was none.
+    */
+    using AckCallback = std::function<void(bool acked, std::chrono::nanoseconds rtt)>;
+
+    /*!
+        Create an event loop.
+
+        \param retransmit_interval - time to wait for an acknowledgement before retransmitting a state change.
+        \param attempts - number of transmissions of a state change before it fails, the first one included.
+        \param window - maximum number of state changes waiting for an acknowledgement.
+
+        \throw std::system_error
+               - `EINVAL` when one of the arguments is not positive
+               - system errors
+    */
+    explicit EventLoop(std::chrono::milliseconds retransmit_interval = std::chrono::milliseconds(100),
+                       std::size_t attempts = 5, std::size_t window = 256);
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+    ~EventLoop() noexcept;
+
+    /*!
+        \brief Send a PING frame to the driver. The callback is invoked from `EventLoop::run_once()`.
+
+        \throw std::system_error
+               - `ENOTCONN` when Controller is not valid (closed)
+               - `EBUSY` when all sequence numbers of the Controller are taken by pending requests
+               - system network layer errors
+    */
+    void ping(Controller& ctl, PingCallback callback);
+
+    /*!
+        \brief Send a STATUS frame to the driver. The callback is invoked from `EventLoop::run_once()`.
+
+        \throw std::system_error
+               - `ENOTCONN` when Controller is not valid (closed)
+               - `EBUSY` when all sequence numbers of the Controller are taken by pending requests
+               - system network layer errors
+    */
+    void status(Controller& ctl, StatusCallback callback);
+
+    /*!
+        \brief Send an acknowledged UPDATE frame. It is sent even when the color persists.
+
+        Once the driver acknowledges the frame the color is cached as the driver status (see
+        `Controller::cached_status()`). When delivery fails the color cache of the controller is invalidated, so the
+        next `Controller::update()` is sent regardless of deduplication.
+
+        \param callback - invoked from `EventLoop::run_once()`, may be empty.
+
+        \throw std::system_error
+               - `ENOTCONN` when Controller is not valid (closed)
+               - `EBUSY` when `window` state changes are in flight, or all sequence numbers of the Controller are
+                 taken by pending requests
+               - system network layer errors
+    */
+    void update(Controller& ctl, const ColorState& state, AckCallback callback = {});
+
+    //! \brief Send an acknowledged POWER frame. See `EventLoop::update()`.
+    void power(Controller& ctl, bool state, AckCallback callback = {});
+
+    //! \brief Send an acknowledged SET_STATE frame. See `EventLoop::update()`.
+    void set_state(Controller& ctl, const Status& state, AckCallback callback = {});
+
+    //! Drop pending requests of the controller without invoking their callbacks. Cancelled state changes invalidate
+    //! the caches as failed ones do, see `EventLoop::update()`.
+    void cancel(const Controller& ctl) noexcept;
+
+    /*!
+        \brief Wait for replies and complete requests: answered ones and those whose timeout expired.
+
+        \param max_wait - maximum time to wait for a reply. Negative waits until at least one request completes.
+
+        \return Number of completed requests.
+
+        \throw std::system_error - system network layer errors. Exceptions thrown by callbacks are propagated.
+    */
+    std::size_t run_once(std::chrono::milliseconds max_wait = std::chrono::milliseconds(-1));
+
+    //! Run `EventLoop::run_once()` until there are no pending requests.
+    void run();
+
+    //! \return Number of pending requests, state changes waiting for an acknowledgement included.
+    std::size_t pending() const noexcept;
+
+  private:
+    using socket_t = Controller::socket_t;
+    using clock = std::chrono::steady_clock;
+
+    // Replies are matched by the socket they arrive on, the source address and the sequence number.
+    struct Key {
+        socket_t fd;
+        sockaddr_storage addr;
+        std::uint16_t sequence;
+    };
+
+    struct KeyHash {
+        std::size_t operator()(const Key& key) const noexcept;
+    };
+
+    struct KeyEqual {
+        bool operator()(const Key& a, const Key& b) const noexcept;
+    };
+
+    struct Request {
+        std::uint64_t id;
+        Controller* ctl;
+        RootHeader header;
+        clock::time_point sent;
+        Metrics* metrics;
+        PingCallback on_pong;
+        StatusCallback on_status;
+
+        // Acknowledged state changes only: `fields` is a mask of `field_color`/`field_power`, zero for PING and
+        // STATUS requests. The frame is kept for retransmission.
+        AckCallback on_ack;
+        std::uint8_t fields;
+        std::uint64_t color;
+        bool power;
+        std::size_t retransmits_left;
+        std::array<std::byte, sizeof(RootHeader) + 8> frame;
+        std::size_t frame_size;
+    };
+
+    static constexpr std::uint8_t field_color = 0x01;
+    static constexpr std::uint8_t field_power = 0x02;
+
+    // Keys of the newest in-flight state changes of a controller, per field.
+    struct Owners {
+        std::optional<Key> color;
+        std::optional<Key> power;
+    };
+
+    struct Timer {
+        clock::time_point deadline;
+        std::uint64_t id;
+        Key key;
+
+        bool operator>(const Timer& other) const noexcept {
+            return deadline > other.deadline;
+        }
+    };
+
+    //! Receive buffer size. Larger datagrams are truncated.
+    static constexpr std::size_t max_datagram_size = 1500;
+
+    //! Number of datagrams read with one `recvmmsg()` call.
+    static constexpr std::size_t batch_size = 64;
+
+    //! Longest wait while requests are pending on a shared socket, whose replies other readers may route to the loop.
+    static constexpr std::chrono::milliseconds shared_poll_interval{5};
+
+    // Preallocated receive ring: `batch_size` buffers of `max_datagram_size` bytes and their source addresses.
+    std::vector<std::byte> ring_;
+    std::vector<sockaddr_storage> sources_;
+
+    std::unordered_map<Key, Request, KeyHash, KeyEqual> requests_;
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<>> timers_;
+
+    struct Watch {
+        std::size_t requests;
+        SharedSocket* shared;  // Set when the socket is shared, replies are routed through it then.
+        std::uint64_t routed;  // `SharedSocket::routed_` when its mailboxes were last collected.
+    };
+
+    // Watched sockets with the number of pending requests on each, and the number of those which are shared.
+    std::unordered_map<socket_t, Watch> watched_;
+    std::size_t shared_watched_{};
+
+#if defined(__linux__)
+    int epoll_fd_{-1};
+#endif
+
+    std::uint64_t next_id_{};
+
+    std::chrono::milliseconds retransmit_interval_;
+    std::size_t attempts_;
+    std::size_t window_;
+
+    // In-flight state changes: their number and the newest ones of each controller.
+    std::size_t deliveries_{};
+    std::unordered_map<const Controller*, Owners> owners_;
+
+    Request& submit_(Controller& ctl, Action action);
+    void deliver_(Controller& ctl, std::uint8_t fields, const Status& state, AckCallback callback);
+    // Hands `field` of the in-flight state change `key` over to a newer one.
+    void supersede_(const Key& key, Owners& owners, std::uint8_t field);
+    // Returns `false` when the retransmission failed and the request has been completed.
+    bool retransmit_(const Key& key, Request& request, clock::time_point now);
+    void release_(const Key& key, const Request& request, bool acked) noexcept;
+    void complete_(const Key& key, std::span<const std::byte> reply, clock::time_point now);
+    std::size_t drain_(socket_t fd, clock::time_point& now);
+    // Completes requests whose replies other readers of shared sockets routed to their mailboxes.
+    std::size_t collect_();
+    // Returns the key of the pending request the datagram replies to, if any.
+    std::optional<Key> match_(socket_t fd, const sockaddr_storage& source, std::span<const std::byte> datagram) const;
+    void watch_(socket_t fd, SharedSocket* shared);
+    void unwatch_(socket_t fd) noexcept;
+};
+
+} // namespace LEDriver
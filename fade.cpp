@@ -0,0 +1,72 @@
+#include <chrono>
+#include <limits>
+#include <mutex>
+#include <optional>
+
+#include <cstdint>
+
+#include <ledriver.hpp>
+#include <tools.hpp>
+
+void LEDriver::Controller::fade_to(const ColorState& target, std::chrono::milliseconds duration, FadeCurve curve) {
+    if (!is_valid())
+        throw std::system_error(ENOTCONN, std::generic_category());
+
+    if (duration.count() < 0 || duration.count() > (std::numeric_limits<std::uint32_t>::max)())
+        throw std::system_error(EINVAL, std::generic_category());
+
+    const std::lock_guard lock(state_mutex_);
+
+    // The driver starts from the color it shows, so does the mirror: an earlier fade continues to be predicted.
+    const auto now = std::chrono::steady_clock::now();
+    std::uint64_t from = color_unknown;
+    if (const auto fading = fade_color_(now))
+        from = *fading;
+    else if (const std::uint64_t cached = status_cache_.load(std::memory_order_acquire); cached & status_color_known)
+        from = cached & status_color_mask;
+
+    // FADE action requires 7-byte payload: the target channel brightness values (3 * u16) and u32 duration in ms,
+    // both in net endian, and u8 curve.
+    const auto frame = FadeFrame::encode(0, target, static_cast<std::uint32_t>(duration.count()), curve);
+    send_({TO_CIOV(frame)});
+
+    // The driver ends at the target, so a plain update to it is deduplicated even while the fade runs.
+    const std::uint64_t packed = PACK_COLOR(target);
+    color_state_cache_.store(packed, std::memory_order_release);
+    cache_color_(target);
+
+    fade_target_.store(color_unknown, std::memory_order_relaxed);
+    fade_from_.store(from, std::memory_order_relaxed);
+    fade_start_.store(now.time_since_epoch().count(), std::memory_order_relaxed);
+    fade_shape_.store(static_cast<std::uint64_t>(duration.count()) | static_cast<std::uint64_t>(curve) << 32,
+                      std::memory_order_relaxed);
+    fade_target_.store(packed, std::memory_order_release);
+}
+
+std::optional<std::uint64_t>
+LEDriver::Controller::fade_color_(std::chrono::steady_clock::time_point now) const noexcept {
+    const std::uint64_t target = fade_target_.load(std::memory_order_acquire);
+    if (target == color_unknown || color_state_cache_.load(std::memory_order_acquire) != target)
+        return std::nullopt;
+
+    const std::uint64_t from = fade_from_.load(std::memory_order_relaxed);
+    const std::chrono::steady_clock::time_point start(
+        std::chrono::steady_clock::duration(fade_start_.load(std::memory_order_relaxed)));
+    const std::uint64_t shape = fade_shape_.load(std::memory_order_relaxed);
+
+    // A concurrent `Controller::fade_to()` has replaced the fields read above.
+    if (fade_target_.load(std::memory_order_acquire) != target)
+        return std::nullopt;
+
+    const std::chrono::milliseconds duration(shape & 0xFFFF'FFFF);
+    const auto elapsed = now - start;
+    if (elapsed >= duration)
+        return target;
+
+    if (from == color_unknown)
+        return color_unknown;
+
+    const double progress = std::chrono::duration<double>(elapsed) / std::chrono::duration<double>(duration);
+    const auto curve = static_cast<FadeCurve>(shape >> 32);
+    return PACK_COLOR(FADE_COLOR(UNPACK_COLOR(from), UNPACK_COLOR(target), curve, progress));
+}
@@ -0,0 +1,508 @@
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <stop_token>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+
+#if defined(_WIN32)
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+
+    #pragma comment(lib, "Ws2_32.lib")
+#else
+    #include <netinet/in.h>
+    #include <poll.h>
+    #include <sys/socket.h>
+    #include <sys/uio.h>
+    #include <unistd.h>
+#endif
+
+#if defined(__linux__)
+    #include <sys/epoll.h>
+#endif
+
+#include <fake_driver.hpp>
+#include <ledriver.hpp>
+#include <tools.hpp>
+
+LEDriver::FakeDriver::FakeDriver(std::size_t count, const sockaddr_storage& addr, FakeDriverOptions options)
+    : options_(options), random_(options.seed), buffers_(batch_size * max_datagram_size) {
+
+    // Support only IP4 and IP6.
+    if (addr.ss_family != AF_INET && addr.ss_family != AF_INET6)
+        throw std::system_error(EINVAL, std::generic_category());
+
+    // If windows, initialize winsock.
+    INIT_SOCKETS();
+
+    try {
+
+#if defined(__linux__)
+        epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_fd_ < 0)
+            throw std::system_error(errno, std::system_category(), "epoll_create1");
+#endif
+
+        const std::uint16_t base_port = DESERIALIZE_U16(addr.ss_family == AF_INET
+                                                            ? reinterpret_cast<const sockaddr_in&>(addr).sin_port
+                                                            : reinterpret_cast<const sockaddr_in6&>(addr).sin6_port);
+
+        devices_.reserve(count);
+        for (std::size_t i = 0; i < count; i++) {
+            Device& device = devices_.emplace_back();
+            device.fd = invalid_socket;
+            device.addr = addr;
+            device.status = {};
+
+            // Bind consecutive ports, or let the system pick them.
+            const std::uint16_t port = base_port == 0 ? 0 : SERIALIZE_U16(static_cast<std::uint16_t>(base_port + i));
+            if (addr.ss_family == AF_INET)
+                reinterpret_cast<sockaddr_in&>(device.addr).sin_port = port;
+            else
+                reinterpret_cast<sockaddr_in6&>(device.addr).sin6_port = port;
+
+            device.fd = ::socket(addr.ss_family, SOCK_DGRAM, 0);
+            if (device.fd == invalid_socket)
+                throw std::system_error(GET_SOCKET_ERROR(), std::system_category(), "socket");
+
+            socklen_t len = SOCKADDR_LEN(device.addr);
+            if (::bind(device.fd, reinterpret_cast<const sockaddr*>(&device.addr), len) != 0)
+                throw std::system_error(GET_SOCKET_ERROR(), std::system_category(), "bind");
+
+            if (::getsockname(device.fd, reinterpret_cast<sockaddr*>(&device.addr), &len) != 0)
+                throw std::system_error(GET_SOCKET_ERROR(), std::system_category(), "getsockname");
+
+#if defined(__linux__)
+            epoll_event event{};
+            event.events = EPOLLIN;
+            event.data.u64 = i;
+            if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, device.fd, &event) != 0)
+                throw std::system_error(errno, std::system_category(), "epoll_ctl");
+#endif
+        }
+
+    } catch (...) {
+        close_();
+        throw;
+    }
+}
+
+LEDriver::FakeDriver::~FakeDriver() noexcept {
+    stop();
+    close_();
+}
+
+std::size_t LEDriver::FakeDriver::size() const noexcept {
+    return devices_.size();
+}
+
+const sockaddr_storage& LEDriver::FakeDriver::address(std::size_t i) const noexcept {
+    return devices_[i].addr;
+}
+
+LEDriver::Status LEDriver::FakeDriver::status(std::size_t i) const {
+    const std::lock_guard lock(state_mutex_);
+    const Device& device = devices_.at(i);
+    return {color_(device, clock::now()), device.status.power};
+}
+
+std::chrono::steady_clock::time_point LEDriver::FakeDriver::applied_at(std::size_t i) const {
+    const std::lock_guard lock(state_mutex_);
+    return devices_.at(i).applied_at;
+}
+
+std::vector<LEDriver::ColorState> LEDriver::FakeDriver::pixels(std::size_t i) const {
+    const std::lock_guard lock(state_mutex_);
+    return devices_.at(i).pixels;
+}
+
+std::size_t LEDriver::FakeDriver::run_once(std::chrono::milliseconds max_wait) {
+    std::size_t handled{};
+
+    // Wait no longer than until the next delayed datagram is due.
+    std::chrono::milliseconds wait = max_wait;
+    if (!delayed_.empty()) {
+        const auto until = std::chrono::ceil<std::chrono::milliseconds>(delayed_.top().due - clock::now());
+        const auto until_ms = std::max(until, std::chrono::milliseconds(0));
+        wait = wait.count() < 0 ? until_ms : std::min(wait, until_ms);
+    }
+
+    const int wait_ms = wait.count() < 0 ? -1 : static_cast<int>(std::min<long long>(wait.count(), INT32_MAX));
+
+#if defined(__linux__)
+    epoll_event events[64];
+    const int ready = ::epoll_wait(epoll_fd_, events, 64, wait_ms);
+    if (ready < 0 && errno != EINTR)
+        throw std::system_error(errno, std::system_category(), "epoll_wait");
+
+    for (int i = 0; i < ready; i++)
+        handled += drain_(static_cast<std::size_t>(events[i].data.u64));
+#else
+    #if defined(_WIN32)
+    std::vector<WSAPOLLFD> fds(devices_.size());
+    #else
+    std::vector<pollfd> fds(devices_.size());
+    #endif
+    for (std::size_t i = 0; i < devices_.size(); i++) {
+        fds[i].fd = devices_[i].fd;
+        fds[i].events = POLLIN;
+    }
+
+    #if defined(_WIN32)
+    const int ready = ::WSAPoll(fds.data(), static_cast<ULONG>(fds.size()), wait_ms);
+    if (ready == SOCKET_ERROR)
+        throw std::system_error(GET_SOCKET_ERROR(), std::system_category(), "WSAPoll");
+    #else
+    const int ready = ::poll(fds.data(), static_cast<nfds_t>(fds.size()), wait_ms);
+    if (ready < 0 && errno != EINTR)
+        throw std::system_error(errno, std::system_category(), "poll");
+    #endif
+
+    for (std::size_t i = 0; ready > 0 && i < fds.size(); i++)
+        if (fds[i].revents != 0)
+            handled += drain_(i);
+#endif
+
+    // Handle delayed datagrams which are due.
+    const auto now = clock::now();
+    while (!delayed_.empty() && delayed_.top().due <= now) {
+        const Delayed& delayed = delayed_.top();
+        handle_(delayed.device, delayed.from, delayed.data);
+        delayed_.pop();
+        handled++;
+    }
+
+    return handled;
+}
+
+void LEDriver::FakeDriver::start() {
+    if (thread_.joinable())
+        return;
+
+    thread_ = std::jthread([this](std::stop_token stop) {
+        while (!stop.stop_requested()) {
+            try {
+                run_once(std::chrono::milliseconds(50));
+            } catch (const std::system_error&) {
+                // Keep serving the other simulated drivers.
+            }
+        }
+    });
+}
+
+void LEDriver::FakeDriver::stop() noexcept {
+    if (!thread_.joinable())
+        return;
+
+    thread_.request_stop();
+    thread_.join();
+}
+
+std::uint64_t LEDriver::FakeDriver::received() const noexcept {
+    return received_.load(std::memory_order_relaxed);
+}
+
+std::uint64_t LEDriver::FakeDriver::dropped() const noexcept {
+    return dropped_.load(std::memory_order_relaxed);
+}
+
+std::uint64_t LEDriver::FakeDriver::replied() const noexcept {
+    return replied_.load(std::memory_order_relaxed);
+}
+
+std::size_t LEDriver::FakeDriver::drain_(std::size_t device) {
+    const socket_t fd = devices_[device].fd;
+    std::size_t handled{};
+
+#if defined(__linux__)
+    // Read up to `batch_size` datagrams per system call until the socket is empty.
+    while (true) {
+        mmsghdr messages[batch_size]{};
+        iovec segments[batch_size]{};
+        sockaddr_storage sources[batch_size]{};
+
+        for (std::size_t i = 0; i < batch_size; i++) {
+            segments[i] = {buffers_.data() + i * max_datagram_size, max_datagram_size};
+            messages[i].msg_hdr.msg_name = &sources[i];
+            messages[i].msg_hdr.msg_namelen = sizeof(sources[i]);
+            messages[i].msg_hdr.msg_iov = &segments[i];
+            messages[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        const int result = ::recvmmsg(fd, messages, batch_size, MSG_DONTWAIT, nullptr);
+        if (result < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+                break;
+            throw std::system_error(errno, std::system_category(), "recvmmsg");
+        }
+
+        for (int i = 0; i < result; i++)
+            handled += accept_(device, sources[i], {buffers_.data() + i * max_datagram_size, messages[i].msg_len});
+
+        if (static_cast<std::size_t>(result) < batch_size)
+            break;
+    }
+#else
+    sockaddr_storage source{};
+    socklen_t source_len = sizeof(source);
+
+    #if defined(_WIN32)
+    const int result = ::recvfrom(fd, reinterpret_cast<CHAR*>(buffers_.data()), max_datagram_size, 0,
+                                  reinterpret_cast<sockaddr*>(&source), &source_len);
+    if (result == SOCKET_ERROR) {
+        const int error = GET_SOCKET_ERROR();
+        if (error == WSAEWOULDBLOCK || error == WSAECONNRESET)
+            return 0;
+        throw std::system_error(error, std::system_category(), "recvfrom");
+    }
+    #else
+    const ssize_t result = ::recvfrom(fd, buffers_.data(), max_datagram_size, MSG_DONTWAIT,
+                                      reinterpret_cast<sockaddr*>(&source), &source_len);
+    if (result < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+            return 0;
+        throw std::system_error(errno, std::system_category(), "recvfrom");
+    }
+    #endif
+
+    handled += accept_(device, source, {buffers_.data(), static_cast<std::size_t>(result)});
+#endif
+
+    return handled;
+}
+
+std::size_t LEDriver::FakeDriver::accept_(std::size_t device, const sockaddr_storage& from,
+                                          std::span<const std::byte> data) {
+    received_.fetch_add(1, std::memory_order_relaxed);
+
+    // Simulate loss.
+    if (options_.loss > 0 && std::uniform_real_distribution<double>(0, 1)(random_) < options_.loss) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return 0;
+    }
+
+    // Simulate latency. Random jitter makes datagrams overtake each other.
+    auto delay = options_.latency;
+    if (options_.jitter.count() > 0)
+        delay += std::chrono::microseconds(
+            std::uniform_int_distribution<std::chrono::microseconds::rep>(0, options_.jitter.count())(random_));
+
+    if (delay.count() > 0) {
+        delayed_.push({clock::now() + delay, device, from, {data.begin(), data.end()}});
+        return 0;
+    }
+
+    handle_(device, from, data);
+    return 1;
+}
+
+void LEDriver::FakeDriver::handle_(std::size_t device, const sockaddr_storage& from,
+                                   std::span<const std::byte> data) {
+    if (data.size() < sizeof(RootHeader))
+        return;
+
+    RootHeader header;
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (DESERIALIZE_U32(header.magic) != RootHeader::magic_value || header.version != RootHeader::protocol_version)
+        return;
+
+    const auto payload = data.subspan(sizeof(RootHeader));
+    const auto read_u16 = [&](std::size_t offset) {
+        return FieldCodec<std::uint16_t>::decode(payload.data() + offset);
+    };
+    const auto read_color = [&](std::size_t offset) {
+        return FieldCodec<ColorState>::decode(payload.data() + offset);
+    };
+
+    Device& target = devices_[device];
+    const std::uint16_t flags = DESERIALIZE_U16(header.flags);
+    const bool timed = (flags & RootHeader::flag_timestamp) != 0;
+
+    // Acknowledged frames are answered with their header once applied.
+    const auto acknowledge = [&]() {
+        if (flags & RootHeader::flag_ack)
+            reply_(device, from, data.first(sizeof(RootHeader)));
+    };
+
+    switch (DESERIALIZE_ACTION(header.action)) {
+    case Action::PING:
+        if (timed)
+            reply_(device, from, TimedPongFrame::encode(flags, clock_()));
+        else
+            reply_(device, from, data.first(sizeof(RootHeader)));
+        break;
+
+    case Action::UPDATE:
+        if (timed && data.size() == TimedUpdateFrame::size) {
+            const auto [presentation, color] = TimedUpdateFrame::decode(data.first<TimedUpdateFrame::size>());
+
+            // Hold the frame until the driver clock reaches the presentation time.
+            if (const std::uint64_t now = clock_(); presentation > now) {
+                const auto frame =
+                    UpdateFrame::encode(static_cast<std::uint16_t>(flags & ~RootHeader::flag_timestamp), color);
+                delayed_.push({clock::now() + std::chrono::microseconds(presentation - now), device, from,
+                               {frame.begin(), frame.end()}});
+                break;
+            }
+
+            {
+                const std::lock_guard lock(state_mutex_);
+                target.status.color = color;
+                target.fade.reset();
+                target.applied_at = clock::now();
+            }
+            acknowledge();
+        } else if (!timed && data.size() == UpdateFrame::size) {
+            const auto [color] = UpdateFrame::decode(data.first<UpdateFrame::size>());
+            {
+                const std::lock_guard lock(state_mutex_);
+                target.status.color = color;
+                target.fade.reset();
+                target.applied_at = clock::now();
+            }
+            acknowledge();
+        }
+        break;
+
+    case Action::POWER:
+        if (data.size() == PowerFrame::size) {
+            const auto [power] = PowerFrame::decode(data.first<PowerFrame::size>());
+            {
+                const std::lock_guard lock(state_mutex_);
+                target.status.power = power;
+            }
+            acknowledge();
+        }
+        break;
+
+    case Action::SET_STATE:
+        if (data.size() == SetStateFrame::size) {
+            const auto [color, power] = SetStateFrame::decode(data.first<SetStateFrame::size>());
+            {
+                const std::lock_guard lock(state_mutex_);
+                target.status = {color, power};
+                target.fade.reset();
+                target.applied_at = clock::now();
+            }
+            acknowledge();
+        }
+        break;
+
+    case Action::FADE:
+        if (data.size() == FadeFrame::size) {
+            const auto [color, duration, curve] = FadeFrame::decode(data.first<FadeFrame::size>());
+            {
+                // A new fade starts from the color shown at the time, also in the middle of a fade.
+                const std::lock_guard lock(state_mutex_);
+                const auto now = clock::now();
+                target.fade = Fade{color_(target, now), color, now, std::chrono::milliseconds(duration), curve};
+                target.status.color = color;
+                target.applied_at = now;
+            }
+            acknowledge();
+        }
+        break;
+
+    case Action::STATUS: {
+        Status status;
+        {
+            const std::lock_guard lock(state_mutex_);
+            status = {color_(target, clock::now()), target.status.power};
+        }
+
+        // Echo the flags, so the reply carries the request sequence number.
+        const auto reply = StatusReplyFrame::encode(flags, status.color, status.power);
+        reply_(device, from, reply);
+        break;
+    }
+
+    case Action::UPDATE_PIXELS: {
+        const bool ranges = (flags & RootHeader::flag_ranges) != 0;
+        const std::lock_guard lock(state_mutex_);
+
+        // A plain payload is a single literal range.
+        std::size_t at{};
+        while (at + 4 <= payload.size()) {
+            const std::size_t offset = read_u16(at);
+            const std::uint16_t count = read_u16(at + 2);
+            at += 4;
+
+            const bool run = ranges && (count & RootHeader::run_bit) != 0;
+            const std::size_t pixels = run ? count & ~RootHeader::run_bit : count;
+            const std::size_t size = run ? 6 : 6 * pixels;
+            if (at + size > payload.size() || offset + pixels > 0x10000)
+                break;
+
+            if (target.pixels.size() < offset + pixels)
+                target.pixels.resize(offset + pixels);
+
+            for (std::size_t i = 0; i < pixels; i++)
+                target.pixels[offset + i] = read_color(run ? at : at + 6 * i);
+
+            at += size;
+            if (!ranges)
+                break;
+        }
+        break;
+    }
+
+    default:
+        break;
+    }
+}
+
+std::uint64_t LEDriver::FakeDriver::clock_() const noexcept {
+    const auto now = std::chrono::duration_cast<std::chrono::microseconds>(clock::now().time_since_epoch());
+    return static_cast<std::uint64_t>(std::max<std::int64_t>((now + options_.clock_offset).count(), 0));
+}
+
+LEDriver::ColorState LEDriver::FakeDriver::color_(const Device& device, clock::time_point now) noexcept {
+    if (!device.fade || now - device.fade->start >= device.fade->duration)
+        return device.status.color;
+
+    const double progress = std::chrono::duration<double>(now - device.fade->start) /
+                            std::chrono::duration<double>(device.fade->duration);
+    return FADE_COLOR(device.fade->from, device.fade->to, device.fade->curve, progress);
+}
+
+void LEDriver::FakeDriver::reply_(std::size_t device, const sockaddr_storage& from, std::span<const std::byte> data) {
+#if defined(_WIN32)
+    const int result = ::sendto(devices_[device].fd, reinterpret_cast<const CHAR*>(data.data()),
+                                static_cast<int>(data.size()), 0, reinterpret_cast<const sockaddr*>(&from),
+                                SOCKADDR_LEN(from));
+    if (result != SOCKET_ERROR)
+        replied_.fetch_add(1, std::memory_order_relaxed);
+#else
+    const ssize_t result = ::sendto(devices_[device].fd, data.data(), data.size(), 0,
+                                    reinterpret_cast<const sockaddr*>(&from), SOCKADDR_LEN(from));
+    if (result >= 0)
+        replied_.fetch_add(1, std::memory_order_relaxed);
+#endif
+}
+
+void LEDriver::FakeDriver::close_() noexcept {
+    for (Device& device : devices_) {
+        if (device.fd == invalid_socket)
+            continue;
+
+#if defined(_WIN32)
+        ::closesocket(device.fd);
+#else
+        ::close(device.fd);
+#endif
+
+        device.fd = invalid_socket;
+    }
+
+#if defined(__linux__)
+    if (epoll_fd_ >= 0)
+        ::close(epoll_fd_);
+    epoll_fd_ = -1;
+#endif
+}
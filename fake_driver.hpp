@@ -0,0 +1,181 @@
+/*!
+    \file
+    \brief Header containing `FakeDriver` class, a server-side implementation of the protocol for testing.
+    \copyright Copyright (c) 2026 Wiktor Sołtys
+    \cond
+        See LICENSE
+    \endcond
+*/
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <random>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <ledriver.hpp>
+
+namespace LEDriver {
+
+//! Network conditions simulated by `FakeDriver`.
+struct FakeDriverOptions {
+    std::chrono::microseconds latency{};      //!< Delay applied to every received datagram before it's handled.
+    std::chrono::microseconds jitter{};       //!< Random extra delay up to this value. Reorders datagrams.
+    double loss{};                            //!< Probability (0-1) of dropping a received datagram.
+    std::uint64_t seed{0x4C454452};           //!< Seed of the loss and jitter generator.
+    std::chrono::microseconds clock_offset{}; //!< Offset of the simulated driver clock from `steady_clock`.
+};
+
+/*!
+    \brief Simulates any number of drivers on one host, each on its own UDP socket.
+
+    Implements the protocol of `LEDriver::Action`: echoes PING, applies UPDATE, UPDATE_PIXELS, POWER and SET_STATE,
+    interpolates FADE, and answers STATUS. All sockets are served by one event loop (`epoll` and `recvmmsg()` on Linux,
+    `poll()`/`WSAPoll()` elsewhere), either on the caller's thread with `FakeDriver::run_once()` or on a background
+    thread with `FakeDriver::start()`.
+*/
+class FakeDriver {
+  public:
+    /*!
+        Create sockets of the simulated drivers.
+
+        \param count - number of simulated drivers.
+        \param addr - IPv4/IPv6 address to bind. Driver `i` binds to port `port + i`, or to an ephemeral port when the
+                      port is 0.
+        \param options - simulated network conditions. See `FakeDriverOptions`.
+
+        \throw std::system_error
+               - `EINVAL` when address family is not supported
+               - system network layer errors
+    */
+    FakeDriver(std::size_t count, const sockaddr_storage& addr, FakeDriverOptions options = {});
+
+    FakeDriver(const FakeDriver&) = delete;
+    FakeDriver& operator=(const FakeDriver&) = delete;
+    ~FakeDriver() noexcept;
+
+    //! \return Number of simulated drivers.
+    std::size_t size() const noexcept;
+
+    //! \return Address of the simulated driver `i`, to be passed to `Controller`.
+    const sockaddr_storage& address(std::size_t i) const noexcept;
+
+    //! \return Current state of the simulated driver `i`, with the current color of a running fade.
+    Status status(std::size_t i) const;
+
+    //! \return Local time the current color of the simulated driver `i` was applied at.
+    std::chrono::steady_clock::time_point applied_at(std::size_t i) const;
+
+    //! \return Current pixels of the simulated driver `i`, as set by UPDATE_PIXELS frames.
+    std::vector<ColorState> pixels(std::size_t i) const;
+
+    /*!
+        \brief Receive and handle datagrams. Must not be called while the background thread runs.
+
+        \param max_wait - maximum time to wait for a datagram. Negative waits without a time limit.
+
+        \return Number of handled datagrams.
+
+        \throw std::system_error - system network layer errors
+    */
+    std::size_t run_once(std::chrono::milliseconds max_wait = std::chrono::milliseconds(-1));
+
+    //! Start serving on a background thread.
+    void start();
+
+    //! Stop the background thread.
+    void stop() noexcept;
+
+    //! \return Number of datagrams received, including dropped ones.
+    std::uint64_t received() const noexcept;
+
+    //! \return Number of datagrams dropped to simulate loss.
+    std::uint64_t dropped() const noexcept;
+
+    //! \return Number of replies sent.
+    std::uint64_t replied() const noexcept;
+
+  private:
+#if defined(_WIN32)
+    using socket_t = SOCKET;
+    static constexpr socket_t invalid_socket = INVALID_SOCKET;
+#else
+    using socket_t = int;
+    static constexpr socket_t invalid_socket = -1;
+#endif
+
+    using clock = std::chrono::steady_clock;
+
+    //! Receive buffer size of a single datagram.
+    static constexpr std::size_t max_datagram_size = 1500;
+
+    //! Number of datagrams read with one `recvmmsg()` call.
+    static constexpr std::size_t batch_size = 32;
+
+    struct Fade {
+        ColorState from;
+        ColorState to;
+        clock::time_point start;
+        std::chrono::milliseconds duration;
+        FadeCurve curve;
+    };
+
+    struct Device {
+        socket_t fd;
+        sockaddr_storage addr;
+        Status status;
+        std::optional<Fade> fade;
+        std::chrono::steady_clock::time_point applied_at;
+        std::vector<ColorState> pixels;
+    };
+
+    struct Delayed {
+        clock::time_point due;
+        std::size_t device;
+        sockaddr_storage from;
+        std::vector<std::byte> data;
+
+        bool operator>(const Delayed& other) const noexcept {
+            return due > other.due;
+        }
+    };
+
+    FakeDriverOptions options_;
+    std::vector<Device> devices_;
+
+    // Guards device state, so it can be read while the background thread runs.
+    mutable std::mutex state_mutex_;
+
+    std::priority_queue<Delayed, std::vector<Delayed>, std::greater<>> delayed_;
+    std::mt19937_64 random_;
+
+    std::vector<std::byte> buffers_;
+
+    std::atomic<std::uint64_t> received_{};
+    std::atomic<std::uint64_t> dropped_{};
+    std::atomic<std::uint64_t> replied_{};
+
+#if defined(__linux__)
+    int epoll_fd_{-1};
+#endif
+
+    std::jthread thread_;
+
+    std::size_t drain_(std::size_t device);
+    std::size_t accept_(std::size_t device, const sockaddr_storage& from, std::span<const std::byte> data);
+    void handle_(std::size_t device, const sockaddr_storage& from, std::span<const std::byte> data);
+    std::uint64_t clock_() const noexcept;
+    static ColorState color_(const Device& device, clock::time_point now) noexcept;
+    void reply_(std::size_t device, const sockaddr_storage& from, std::span<const std::byte> data);
+    void close_() noexcept;
+};
+
+} // namespace LEDriver
@@ -0,0 +1,81 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include <cstdint>
+#include <cstdlib>
+
+#if defined(_WIN32)
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+
+    #pragma comment(lib, "Ws2_32.lib")
+#else
+    #include <arpa/inet.h>
+    #include <sys/socket.h>
+#endif
+
+#include <fake_driver.hpp>
+#include <ledriver.hpp>
+
+namespace {
+
+constexpr auto print_help = []() {
+    std::cout << "Usage: (4|6) ip base_port count [latency_ms jitter_ms loss]" << std::endl;
+    std::cout << "Simulates `count` drivers on ports base_port..base_port+count-1" << std::endl;
+    std::cout << "Value loss must be in the range 0-1" << std::endl;
+};
+
+} // namespace
+
+int main(int argn, char* argv[]) {
+
+    // Check argn.
+    if (argn != 5 && argn != 8) {
+        print_help();
+        return EXIT_FAILURE;
+    }
+
+    // Check the validity of the first argument (address family).
+    if (std::string(argv[1]) != "4" && std::string(argv[1]) != "6") {
+        print_help();
+        return EXIT_FAILURE;
+    }
+
+    // Convert second and third arguments (address and base port) to sockaddr.
+    sockaddr_storage ss{};
+    const int family = std::string(argv[1]) == "4" ? AF_INET : AF_INET6;
+    if (family == AF_INET) {
+        sockaddr_in* in = reinterpret_cast<sockaddr_in*>(&ss);
+        in->sin_family = family;
+        ::inet_pton(AF_INET, argv[2], &in->sin_addr);
+        in->sin_port = ::htons(static_cast<std::uint16_t>(std::stoul(argv[3])));
+    } else {
+        sockaddr_in6* in6 = reinterpret_cast<sockaddr_in6*>(&ss);
+        in6->sin6_family = family;
+        ::inet_pton(AF_INET6, argv[2], &in6->sin6_addr);
+        in6->sin6_port = ::htons(static_cast<std::uint16_t>(std::stoul(argv[3])));
+    }
+
+    const std::size_t count = std::stoul(argv[4]);
+
+    // Get simulated network conditions from optional arguments.
+    LEDriver::FakeDriverOptions options;
+    if (argn == 8) {
+        options.latency = std::chrono::milliseconds(std::stoul(argv[5]));
+        options.jitter = std::chrono::milliseconds(std::stoul(argv[6]));
+        options.loss = std::stod(argv[7]);
+    }
+
+    // Create and start simulated drivers.
+    LEDriver::FakeDriver driver(count, ss, options);
+    driver.start();
+
+    // Print counters until killed.
+    while (true) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        std::cout << "received " << driver.received() << ", dropped " << driver.dropped() << ", replied "
+                  << driver.replied() << std::endl;
+    }
+}
@@ -0,0 +1,411 @@
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <utility>
+
+#include <cerrno>
+#include <cstddef>
+
+#if defined(_WIN32)
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+
+    #pragma comment(lib, "Ws2_32.lib")
+#else
+    #include <sys/socket.h>
+    #include <sys/uio.h>
+    #include <unistd.h>
+#endif
+
+#include <group.hpp>
+#if defined(LEDRIVER_IO_URING)
+    #include <io_ring.hpp>
+#endif
+#include <ledriver.hpp>
+#include <metrics.hpp>
+#include <tools.hpp>
+
+LEDriver::ControllerGroup::ControllerGroup() noexcept = default;
+
+LEDriver::ControllerGroup::ControllerGroup(ControllerGroup&& other) noexcept
+    : fd4_(std::exchange(other.fd4_, invalid_socket)), fd6_(std::exchange(other.fd6_, invalid_socket)),
+      priority_(other.priority_), frames_(std::move(other.frames_)), queued_(std::move(other.queued_)) {
+#if defined(LEDRIVER_IO_URING)
+    uring_ = std::move(other.uring_);
+    uring_unavailable_ = other.uring_unavailable_;
+#endif
+}
+
+LEDriver::ControllerGroup& LEDriver::ControllerGroup::operator=(ControllerGroup&& other) noexcept {
+    if (this == &other)
+        return *this;
+
+    close_();
+    fd4_ = std::exchange(other.fd4_, invalid_socket);
+    fd6_ = std::exchange(other.fd6_, invalid_socket);
+    priority_ = other.priority_;
+    frames_ = std::move(other.frames_);
+    queued_ = std::move(other.queued_);
+#if defined(LEDRIVER_IO_URING)
+    uring_ = std::move(other.uring_);
+    uring_unavailable_ = other.uring_unavailable_;
+#endif
+
+    return *this;
+}
+
+LEDriver::ControllerGroup::~ControllerGroup() noexcept {
+    close_();
+}
+
+void LEDriver::ControllerGroup::update(Controller& ctl, const ColorState& state) {
+    if (!ctl.is_valid())
+        throw std::system_error(ENOTCONN, std::generic_category());
+
+    Frame* frame = queue_(ctl, state);
+    if (!frame)
+        return;
+
+    // Patch the channel brightness values into a copy of the precomputed frame.
+    auto update_frame = UPDATE_FRAME;
+    update_frame.set<0>(state);
+    std::copy(update_frame.bytes.begin(), update_frame.bytes.end(), frame->data.begin());
+    frame->size = update_frame.bytes.size();
+}
+
+void LEDriver::ControllerGroup::update_at(Controller& ctl, const ColorState& state,
+                                          std::chrono::steady_clock::time_point at) {
+    if (!ctl.is_valid())
+        throw std::system_error(ENOTCONN, std::generic_category());
+
+    const std::uint64_t presentation = ctl.to_driver_time(at);
+
+    Frame* frame = queue_(ctl, state);
+    if (!frame)
+        return;
+
+    auto update_frame = TIMED_UPDATE_FRAME;
+    update_frame.set<0>(presentation);
+    update_frame.set<1>(state);
+    std::copy(update_frame.bytes.begin(), update_frame.bytes.end(), frame->data.begin());
+    frame->size = update_frame.bytes.size();
+}
+
+std::size_t LEDriver::ControllerGroup::flush() {
+    std::size_t sent{};
+
+    try {
+
+        // Send runs of frames sharing the address family with one batch each.
+        while (sent < frames_.size()) {
+            const int family = frames_[sent].ctl->addr_.ss_family;
+
+            std::size_t count = 1;
+            while (sent + count < frames_.size() && frames_[sent + count].ctl->addr_.ss_family == family)
+                count++;
+
+            // A batch cut short is resumed from the first unsent frame, which reports the actual error.
+            const std::size_t result = send_batch_(socket_(family), frames_.data() + sent, count);
+            if (result == 0)
+                throw std::system_error(EIO, std::generic_category());
+
+            for (std::size_t i = sent; i < sent + result; i++)
+                if (Metrics* metrics = frames_[i].ctl->metrics_.load(std::memory_order_acquire))
+                    metrics->sent_(static_cast<std::uint8_t>(frames_[i].data[offsetof(RootHeader, action)]),
+                                   frames_[i].size);
+
+            sent += result;
+        }
+
+    } catch (...) {
+
+        // Keep only frames which have not been sent.
+        drop_front_(sent);
+        throw;
+    }
+
+    drop_front_(sent);
+    return sent;
+}
+
+std::size_t LEDriver::ControllerGroup::pending() const noexcept {
+    return frames_.size();
+}
+
+void LEDriver::ControllerGroup::clear() noexcept {
+    frames_.clear();
+    queued_.clear();
+}
+
+LEDriver::ControllerGroup::Frame* LEDriver::ControllerGroup::queue_(Controller& ctl, const ColorState& state) {
+    const auto queued = queued_.find(&ctl);
+
+    // Read the cache under the state lock, so a change being sent by the controller itself is seen complete.
+    std::uint64_t seen;
+    {
+        const std::lock_guard lock(ctl.state_mutex_);
+        seen = ctl.color_state_cache_.load(std::memory_order_relaxed);
+    }
+
+    // If the color state persists, do not send, nor an older state queued meanwhile.
+    if (PACK_COLOR(state) == seen) {
+        if (queued != queued_.end()) {
+            // Move the last frame into the hole.
+            const std::size_t index = queued->second;
+            queued_.erase(queued);
+            if (index != frames_.size() - 1) {
+                frames_[index] = frames_.back();
+                queued_.find(frames_[index].ctl)->second = index;
+            }
+            frames_.pop_back();
+        }
+
+        if (Metrics* metrics = ctl.metrics_.load(std::memory_order_acquire))
+            metrics->deduped_.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    // A newer state replaces the queued frame, so the driver ends on the last state requested.
+    if (queued != queued_.end()) {
+        Frame& frame = frames_[queued->second];
+        frame.state = state;
+        frame.seen = seen;
+        return &frame;
+    }
+
+    queued_.emplace(&ctl, frames_.size());
+    try {
+        Frame& frame = frames_.emplace_back();
+        frame.ctl = &ctl;
+        frame.state = state;
+        frame.seen = seen;
+        return &frame;
+    } catch (...) {
+        queued_.erase(&ctl);
+        throw;
+    }
+}
+
+void LEDriver::ControllerGroup::drop_front_(std::size_t first) noexcept {
+    for (std::size_t i = 0; i < first; i++) {
+        Controller& ctl = *frames_[i].ctl;
+        const std::lock_guard lock(ctl.state_mutex_);
+
+        // A change sent by the controller itself since queueing raced with the batch, so the driver may show either.
+        // Forget the color then, so the next update is sent regardless of deduplication.
+        std::uint64_t seen = frames_[i].seen;
+        if (ctl.color_state_cache_.compare_exchange_strong(seen, PACK_COLOR(frames_[i].state),
+                                                           std::memory_order_acq_rel, std::memory_order_relaxed))
+            ctl.cache_color_(frames_[i].state);
+        else
+            ctl.color_state_cache_.store(Controller::color_unknown, std::memory_order_release);
+    }
+
+    if (first == frames_.size()) {
+        frames_.clear();
+        queued_.clear();
+        return;
+    }
+
+    for (std::size_t i = 0; i < first; i++)
+        queued_.erase(frames_[i].ctl);
+    frames_.erase(frames_.begin(), frames_.begin() + static_cast<std::ptrdiff_t>(first));
+
+    for (auto& entry : queued_)
+        entry.second -= first;
+}
+
+LEDriver::ControllerGroup::socket_t LEDriver::ControllerGroup::socket_(int family) {
+    socket_t& fd = family == AF_INET ? fd4_ : fd6_;
+    if (fd != invalid_socket)
+        return fd;
+
+    // Winsock is already initialized by the queued Controller.
+    fd = ::socket(family, SOCK_DGRAM, 0);
+    if (fd == invalid_socket)
+        throw std::system_error(GET_SOCKET_ERROR(), std::system_category(), "socket");
+
+    if (priority_ != Priority::NORMAL) {
+        try {
+            SET_PRIORITY(fd, family, priority_);
+        } catch (...) {
+#if defined(_WIN32)
+            ::closesocket(fd);
+#else
+            ::close(fd);
+#endif
+            fd = invalid_socket;
+            throw;
+        }
+    }
+
+#if defined(LEDRIVER_IO_URING)
+    // A socket which cannot be put into the running ring would never be sent from, so the ring is dropped instead.
+    if (uring_) {
+        try {
+            uring_->set_file(family == AF_INET ? 0 : 1, fd);
+        } catch (const std::system_error&) {
+            uring_.reset();
+            uring_unavailable_ = true;
+        }
+    }
+#endif
+
+    return fd;
+}
+
+#if defined(LEDRIVER_IO_URING)
+LEDriver::IoRing* LEDriver::ControllerGroup::ring_() noexcept {
+    if (uring_ || uring_unavailable_)
+        return uring_.get();
+
+    // Without io_uring (an old kernel, seccomp or `kernel.io_uring_disabled`) batches go out with `sendmmsg()`.
+    try {
+        auto ring = std::make_unique<IoRing>(ring_entries, 2);
+        if (fd4_ != invalid_socket)
+            ring->set_file(0, fd4_);
+        if (fd6_ != invalid_socket)
+            ring->set_file(1, fd6_);
+        uring_ = std::move(ring);
+    } catch (const std::exception&) {
+        uring_unavailable_ = true;
+    }
+
+    return uring_.get();
+}
+#endif
+
+std::size_t LEDriver::ControllerGroup::send_batch_(socket_t fd, Frame* frames, std::size_t count) {
+#if defined(LEDRIVER_IO_URING)
+    // Submit ring-fulls of linked sends straight from the queued frames, with fixed files 0 (IPv4) and 1 (IPv6).
+    if (IoRing* ring = ring_()) {
+        const unsigned file = fd == fd4_ ? 0 : 1;
+
+        std::size_t sent{};
+        while (sent < count) {
+            const std::size_t chunk = std::min<std::size_t>(count - sent, ring->entries());
+            for (std::size_t i = 0; i < chunk; i++) {
+                const Frame& frame = frames[sent + i];
+                ring->prepare_send(frame.data.data(), frame.size, file, frame.ctl->addr_);
+            }
+
+            std::size_t result;
+            try {
+                result = ring->submit();
+            } catch (const std::system_error&) {
+                if (sent != 0)
+                    return sent;
+                throw;
+            }
+
+            sent += result;
+            if (result != chunk)
+                return sent;
+        }
+
+        return sent;
+    }
+#endif
+
+#if defined(__linux__)
+    // Build message descriptors on the stack, in chunks of `batch_size` frames per `sendmmsg()` call.
+    constexpr std::size_t batch_size = 64;
+
+    std::size_t sent{};
+    while (sent < count) {
+        mmsghdr messages[batch_size]{};
+        iovec segments[batch_size]{};
+
+        const std::size_t chunk = std::min(count - sent, batch_size);
+        for (std::size_t i = 0; i < chunk; i++) {
+            Frame& frame = frames[sent + i];
+            segments[i] = {frame.data.data(), frame.size};
+
+            messages[i].msg_hdr.msg_name = &frame.ctl->addr_;
+            messages[i].msg_hdr.msg_namelen = SOCKADDR_LEN(frame.ctl->addr_);
+            messages[i].msg_hdr.msg_iov = &segments[i];
+            messages[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        const int result = ::sendmmsg(fd, messages, static_cast<unsigned int>(chunk), 0);
+        if (result < 0) {
+            if (sent != 0)
+                return sent;
+            throw std::system_error(GET_SOCKET_ERROR(), std::system_category(), "sendmmsg");
+        }
+
+        for (int i = 0; i < result; i++)
+            if (messages[i].msg_len != frames[sent + i].size)
+                return sent + static_cast<std::size_t>(i);
+
+        sent += static_cast<std::size_t>(result);
+        if (static_cast<std::size_t>(result) != chunk)
+            return sent;
+    }
+
+    return sent;
+#else
+    for (std::size_t i = 0; i < count; i++) {
+        Frame& frame = frames[i];
+
+    #if defined(_WIN32)
+        WSABUF segment{};
+        segment.buf = reinterpret_cast<CHAR*>(frame.data.data());
+        segment.len = static_cast<ULONG>(frame.size);
+
+        DWORD sent;
+        if (::WSASendTo(fd, &segment, 1, &sent, 0, reinterpret_cast<const sockaddr*>(&frame.ctl->addr_),
+                        SOCKADDR_LEN(frame.ctl->addr_), nullptr, nullptr) == SOCKET_ERROR) {
+            if (i != 0)
+                return i;
+            throw std::system_error(GET_SOCKET_ERROR(), std::system_category(), "WSASendTo");
+        }
+
+        if (static_cast<std::size_t>(sent) != frame.size)
+            return i;
+    #else
+        iovec segment{frame.data.data(), frame.size};
+
+        msghdr hdr{};
+        hdr.msg_name = &frame.ctl->addr_;
+        hdr.msg_namelen = SOCKADDR_LEN(frame.ctl->addr_);
+        hdr.msg_iov = &segment;
+        hdr.msg_iovlen = 1;
+
+        const ssize_t result = ::sendmsg(fd, &hdr, 0);
+        if (result < 0) {
+            if (i != 0)
+                return i;
+            throw std::system_error(GET_SOCKET_ERROR(), std::system_category(), "sendmsg");
+        }
+
+        if (static_cast<std::size_t>(result) != frame.size)
+            return i;
+    #endif
+    }
+
+    return count;
+#endif
+}
+
+void LEDriver::ControllerGroup::close_() noexcept {
+#if defined(LEDRIVER_IO_URING)
+    // The ring holds references to the sockets, so it goes first.
+    uring_.reset();
+#endif
+
+    for (socket_t* fd : {&fd4_, &fd6_}) {
+        if (*fd == invalid_socket)
+            continue;
+
+#if defined(_WIN32)
+        ::closesocket(*fd);
+#else
+        ::close(*fd);
+#endif
+
+        *fd = invalid_socket;
+    }
+}
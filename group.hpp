@@ -0,0 +1,160 @@
+/*!
+    \file
+    \brief Header containing `ControllerGroup` class, used to transmit frames for many drivers at once.
+    \copyright Copyright (c) 2026 Wiktor Sołtys
+    \cond
+        See LICENSE
+    \endcond
+*/
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <ledriver.hpp>
+
+namespace LEDriver {
+
+#if defined(LEDRIVER_IO_URING)
+class IoRing;
+#endif
+
+/*!
+    \brief A move-only class collecting UPDATE frames for many controllers and transmitting them in as few system calls
+           as possible.
+
+    Frames are sent from the group's own unconnected UDP sockets (one per address family), addressed to
+    `Controller::address()`. On Linux a whole batch goes out with a single `sendmmsg()` call, elsewhere the frames are
+    sent one by one. Built with the `LEDRIVER_IO_URING` CMake option, batches are submitted through the group's own
+    io_uring instead (see `IoRing`), falling back to `sendmmsg()` when the kernel does not support it.
+
+    Queued controllers must outlive the group or the next `ControllerGroup::flush()`, whichever comes first. They may
+    be updated directly meanwhile: a flushed color is cached only when no direct change was made since it was queued,
+    otherwise the color cache is invalidated, as the driver may show either.
+*/
+class ControllerGroup {
+  public:
+    //! Create an empty group. Sockets are created on the first `ControllerGroup::flush()`.
+    ControllerGroup() noexcept;
+
+    ControllerGroup(ControllerGroup&&) noexcept;
+    ControllerGroup& operator=(ControllerGroup&&) noexcept;
+    ControllerGroup(const ControllerGroup&) = delete;
+    ControllerGroup& operator=(const ControllerGroup&) = delete;
+    ~ControllerGroup() noexcept;
+
+    /*!
+        \brief Queue an UPDATE frame for the controller. Nothing is sent until `ControllerGroup::flush()`.
+               Like `Controller::update()`, the frame is skipped when the color state persists.
+
+        At most one frame per controller is queued: a newer state replaces the queued frame, or drops it when the
+        driver already shows the newer state.
+
+        \param ctl - controller to update.
+        \param state - color state. See `ColorState`.
+
+        \throw std::system_error
+               - `ENOTCONN` when Controller is not valid (closed)
+    */
+    void update(Controller& ctl, const ColorState& state);
+
+    /*!
+        \brief Queue a timestamped UPDATE frame for the controller, applied by the driver at the time `at`.
+               See `Controller::update_at()`. Nothing is sent until `ControllerGroup::flush()`. Replaces or drops a
+               queued frame of the controller, as `ControllerGroup::update()`.
+
+        \param ctl - controller to update. Its clock must be synchronized with `Controller::sync_clock()`.
+        \param state - color state. See `ColorState`.
+        \param at - local time of presentation.
+
+        \throw std::system_error
+               - `ENOTCONN` when Controller is not valid (closed)
+               - `EINVAL` when the clock of the controller has not been synchronized
+    */
+    void update_at(Controller& ctl, const ColorState& state, std::chrono::steady_clock::time_point at);
+
+    /*!
+        \brief Send all queued frames. Controllers' color state caches are updated for frames which have been sent.
+
+        \return Number of frames sent.
+
+        \throw std::system_error
+               - `EIO` when a frame was sent only partially
+               - system network layer errors
+
+        When an error is thrown, frames not sent yet stay queued.
+    */
+    std::size_t flush();
+
+    //! \return Number of queued frames.
+    std::size_t pending() const noexcept;
+
+    //! Drop all queued frames.
+    void clear() noexcept;
+
+    /*!
+        \brief Mark datagrams sent by the group with a priority class, e.g. `Priority::BULK` for color streams, so
+               control frames of controllers marked `Priority::CONTROL` bypass them. See `Priority`.
+
+        \param priority - priority class, applied to the sockets created so far and later ones.
+
+        \throw std::system_error - system network layer errors
+    */
+    void set_priority(Priority priority);
+
+  private:
+    using socket_t = Controller::socket_t;
+    static constexpr socket_t invalid_socket = Controller::invalid_socket;
+
+    struct Frame {
+        Controller* ctl;
+        ColorState state;
+        std::uint64_t seen; // `Controller::color_state_cache_` when queued, to detect changes sent meanwhile.
+
+        // Serialized UPDATE frame: header, optional u64 presentation time and 3 * u16 payload.
+        std::array<std::byte, sizeof(RootHeader) + 8 + 6> data;
+        std::size_t size;
+    };
+
+    socket_t fd4_{invalid_socket};
+    socket_t fd6_{invalid_socket};
+    Priority priority_{Priority::NORMAL};
+
+    std::vector<Frame> frames_;
+
+    // Index of the queued frame of every controller in `frames_`.
+    std::unordered_map<const Controller*, std::size_t> queued_;
+
+#if defined(LEDRIVER_IO_URING)
+    //! Number of frames submitted with one `io_uring_enter()` call.
+    static constexpr unsigned ring_entries = 256;
+
+    std::unique_ptr<IoRing> uring_;
+    bool uring_unavailable_{};
+
+    IoRing* ring_() noexcept;
+#endif
+
+    /*!
+        \brief Find or add the queued frame of the controller for a new state.
+
+        \return Frame to encode the state into, or `nullptr` when the driver already shows the state and nothing is
+                queued for the controller anymore.
+    */
+    Frame* queue_(Controller& ctl, const ColorState& state);
+
+    //! Keep only frames from `first` on, e.g. the ones not sent yet, caching the colors of the dropped ones.
+    void drop_front_(std::size_t first) noexcept;
+
+    socket_t socket_(int family);
+    std::size_t send_batch_(socket_t fd, Frame* frames, std::size_t count);
+    void close_() noexcept;
+};
+
+} // namespace LEDriver
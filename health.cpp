@@ -0,0 +1,94 @@
+#include <algorithm>
+#include <chrono>
+#include <optional>
+#include <span>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <cerrno>
+#include <cstddef>
+
+#include <event_loop.hpp>
+#include <health.hpp>
+#include <ledriver.hpp>
+
+namespace {
+
+using clock = std::chrono::steady_clock;
+
+/*!
+    Send one request per controller with `submit(loop, ctl, index)` and run the loop until every request completed
+    or the deadline passed. Callbacks store their results and mark `done`.
+*/
+template <typename Result, typename Submit>
+std::vector<Result> SWEEP(std::span<LEDriver::Controller> controllers, clock::time_point deadline,
+                          std::size_t max_in_flight, Submit submit) {
+    if (max_in_flight == 0)
+        throw std::system_error(EINVAL, std::generic_category());
+
+    LEDriver::EventLoop loop;
+    std::vector<Result> results(controllers.size());
+    std::vector<clock::time_point> sent(controllers.size());
+    std::vector<bool> done(controllers.size());
+
+    std::size_t next{};
+    while (true) {
+        auto now = clock::now();
+
+        // Keep up to `max_in_flight` requests pending. A failed send fails its own request only.
+        while (next < controllers.size() && loop.pending() < max_in_flight && now < deadline) {
+            const std::size_t i = next++;
+            sent[i] = now;
+            try {
+                submit(loop, controllers[i], i, results, done);
+            } catch (const std::system_error&) {
+                done[i] = true;
+            }
+        }
+
+        if (now >= deadline || (loop.pending() == 0 && next == controllers.size()))
+            break;
+
+        const auto left = std::chrono::ceil<std::chrono::milliseconds>(deadline - now);
+        loop.run_once(left);
+    }
+
+    // Drop requests unanswered by the deadline, their results keep the time waited.
+    const auto now = clock::now();
+    for (std::size_t i = 0; i < next; i++) {
+        if (done[i])
+            continue;
+        loop.cancel(controllers[i]);
+        results[i].rtt = now - sent[i];
+    }
+
+    return results;
+}
+
+} // namespace
+
+std::vector<LEDriver::PingResult> LEDriver::ping_all(std::span<Controller> controllers, clock::time_point deadline,
+                                                     std::size_t max_in_flight) {
+    return SWEEP<PingResult>(controllers, deadline, max_in_flight,
+                             [](EventLoop& loop, Controller& ctl, std::size_t i, std::vector<PingResult>& results,
+                                std::vector<bool>& done) {
+                                 loop.ping(ctl, [&results, &done, i](bool pong, std::chrono::nanoseconds rtt) {
+                                     results[i] = {pong, rtt};
+                                     done[i] = true;
+                                 });
+                             });
+}
+
+std::vector<LEDriver::StatusResult> LEDriver::status_all(std::span<Controller> controllers,
+                                                         clock::time_point deadline, std::size_t max_in_flight) {
+    return SWEEP<StatusResult>(
+        controllers, deadline, max_in_flight,
+        [](EventLoop& loop, Controller& ctl, std::size_t i, std::vector<StatusResult>& results,
+           std::vector<bool>& done) {
+            loop.status(ctl, [&results, &done, i](std::optional<Status> status, std::chrono::nanoseconds rtt) {
+                results[i] = {std::move(status), rtt};
+                done[i] = true;
+            });
+        });
+}
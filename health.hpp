@@ -0,0 +1,63 @@
+/*!
+    \file
+    \brief Header containing `ping_all()` and `status_all()`, health checks of a whole fleet within one deadline.
+    \copyright Copyright (c) 2026 Wiktor Sołtys
+    \cond
+        See LICENSE
+    \endcond
+*/
+#pragma once
+
+#include <chrono>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include <cstddef>
+
+#include <ledriver.hpp>
+
+namespace LEDriver {
+
+//! Result of one PING of `ping_all()`.
+struct PingResult {
+    bool pong{};                    //!< `true` when the driver returned correct PONG frame.
+    std::chrono::nanoseconds rtt{}; //!< Round trip time, or time waited when there was no reply.
+};
+
+//! Result of one STATUS request of `status_all()`.
+struct StatusResult {
+    std::optional<Status> status;   //!< Driver status, empty when there was no valid reply.
+    std::chrono::nanoseconds rtt{}; //!< Round trip time, or time waited when there was no reply.
+};
+
+/*!
+    \brief PING every controller at once and collect the replies until one overall deadline.
+
+    Requests are sent up front through an `EventLoop`, at most `max_in_flight` at a time, and the replies are
+    collected as they arrive, so the whole sweep takes about one round trip instead of one per controller. A request
+    also fails when the timeout set in its controller's constructor expires first. A lost request of a controller
+    without timeout holds its slot until the deadline. Requests not sent by the deadline fail with zero `rtt`. Closed
+    controllers and network errors fail their own request only.
+
+    The controllers must not be used by other threads for the duration of the call.
+
+    \param controllers - controllers to check.
+    \param deadline - time by which the sweep returns.
+    \param max_in_flight - maximum number of requests waiting for a reply.
+
+    \return Results in the order of `controllers`.
+
+    \throw std::system_error
+           - `EINVAL` when `max_in_flight` is zero
+           - system errors
+*/
+std::vector<PingResult> ping_all(std::span<Controller> controllers, std::chrono::steady_clock::time_point deadline,
+                                 std::size_t max_in_flight = 1024);
+
+//! \brief Request the status of every controller at once. See `ping_all()`.
+std::vector<StatusResult> status_all(std::span<Controller> controllers,
+                                     std::chrono::steady_clock::time_point deadline,
+                                     std::size_t max_in_flight = 1024);
+
+} // namespace LEDriver
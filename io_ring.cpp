@@ -0,0 +1,219 @@
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstring>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <io_ring.hpp>
+#include <ledriver.hpp>
+#include <tools.hpp>
+
+namespace {
+
+int IO_URING_SETUP(unsigned entries, io_uring_params& params) noexcept {
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+}
+
+int IO_URING_ENTER(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) noexcept {
+    return static_cast<int>(::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+int IO_URING_REGISTER(int fd, unsigned opcode, const void* arg, unsigned count) noexcept {
+    return static_cast<int>(::syscall(__NR_io_uring_register, fd, opcode, arg, count));
+}
+
+void* MAP_RING(int fd, std::size_t size, off_t offset) {
+    void* map = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+    if (map == MAP_FAILED)
+        throw std::system_error(errno, std::system_category(), "mmap");
+
+    return map;
+}
+
+// The kernel writes ring indices from another context, so they are accessed atomically.
+unsigned LOAD_ACQUIRE(unsigned* value) noexcept {
+    return std::atomic_ref<unsigned>(*value).load(std::memory_order_acquire);
+}
+
+void STORE_RELEASE(unsigned* value, unsigned v) noexcept {
+    std::atomic_ref<unsigned>(*value).store(v, std::memory_order_release);
+}
+
+} // namespace
+
+LEDriver::IoRing::IoRing(unsigned entries, unsigned files) {
+    if (!std::has_single_bit(entries) || files == 0)
+        throw std::system_error(EINVAL, std::generic_category());
+
+    try {
+        // Every queued send produces exactly one completion, even when an earlier send has failed.
+        io_uring_params params{};
+        params.flags = IORING_SETUP_SUBMIT_ALL;
+
+        fd_ = IO_URING_SETUP(entries, params);
+        if (fd_ < 0)
+            throw std::system_error(errno, std::system_category(), "io_uring_setup");
+
+        entries_ = params.sq_entries;
+
+        // Map the rings; newer kernels share one mapping for both.
+        sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        if (params.features & IORING_FEAT_SINGLE_MMAP)
+            sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+
+        sq_ring_ = MAP_RING(fd_, sq_ring_size_, IORING_OFF_SQ_RING);
+        cq_ring_ = (params.features & IORING_FEAT_SINGLE_MMAP) ? sq_ring_
+                                                                : MAP_RING(fd_, cq_ring_size_, IORING_OFF_CQ_RING);
+
+        sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+        sqes_ = MAP_RING(fd_, sqes_size_, IORING_OFF_SQES);
+
+        std::byte* sq = static_cast<std::byte*>(sq_ring_);
+        sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sq_mask_ = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+
+        std::byte* cq = static_cast<std::byte*>(cq_ring_);
+        cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cq_mask_ = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes_ = cq + params.cq_off.cqes;
+
+        // Submission queue entries are always used in order, so the indirection array is the identity.
+        for (unsigned i = 0; i < entries_; i++)
+            sq_array_[i] = i;
+
+        // Start with an empty (sparse) table, sockets are put in with `IoRing::set_file()`.
+        const std::vector<int> table(files, -1);
+        if (IO_URING_REGISTER(fd_, IORING_REGISTER_FILES, table.data(), files) < 0)
+            throw std::system_error(errno, std::system_category(), "io_uring_register");
+
+        sizes_.resize(entries_);
+        results_.resize(entries_);
+
+        // Probe the kernel with a send from the empty fixed file. A kernel which accepts the destination address fails
+        // it only when looking up the file.
+        sockaddr_storage probe{};
+        probe.ss_family = AF_INET;
+
+        const std::byte data{};
+        prepare_send(&data, sizeof(data), 0, probe);
+        try {
+            submit();
+        } catch (const std::system_error& se) {
+            if (se.code().value() != EBADF)
+                throw std::system_error(EOPNOTSUPP, std::generic_category(), "io_uring");
+        }
+    } catch (...) {
+        close_();
+        throw;
+    }
+}
+
+LEDriver::IoRing::~IoRing() noexcept {
+    close_();
+}
+
+unsigned LEDriver::IoRing::entries() const noexcept {
+    return entries_;
+}
+
+void LEDriver::IoRing::set_file(unsigned index, int fd) {
+    io_uring_files_update update{};
+    update.offset = index;
+    update.fds = reinterpret_cast<std::uint64_t>(&fd);
+
+    if (IO_URING_REGISTER(fd_, IORING_REGISTER_FILES_UPDATE, &update, 1) < 0)
+        throw std::system_error(errno, std::system_category(), "io_uring_register");
+}
+
+void LEDriver::IoRing::prepare_send(const void* data, std::size_t size, unsigned file,
+                                    const sockaddr_storage& to) noexcept {
+    const unsigned tail = *sq_tail_ + queued_;
+    io_uring_sqe& sqe = static_cast<io_uring_sqe*>(sqes_)[tail & *sq_mask_];
+    std::memset(&sqe, 0, sizeof(sqe));
+
+    // Sends are linked, so the first failure cancels the ones queued after it.
+    sqe.opcode = IORING_OP_SEND;
+    sqe.flags = IOSQE_FIXED_FILE | IOSQE_IO_LINK;
+    sqe.fd = static_cast<std::int32_t>(file);
+    sqe.addr = reinterpret_cast<std::uint64_t>(data);
+    sqe.len = static_cast<std::uint32_t>(size);
+    sqe.addr2 = reinterpret_cast<std::uint64_t>(&to);
+    sqe.addr_len = static_cast<std::uint16_t>(SOCKADDR_LEN(to));
+    sqe.user_data = queued_;
+
+    sizes_[queued_] = static_cast<std::uint32_t>(size);
+    queued_++;
+}
+
+std::size_t LEDriver::IoRing::submit() {
+    const unsigned count = std::exchange(queued_, 0);
+    if (count == 0)
+        return 0;
+
+    // End the chain at the last send.
+    const unsigned tail = *sq_tail_;
+    static_cast<io_uring_sqe*>(sqes_)[(tail + count - 1) & *sq_mask_].flags &= ~IOSQE_IO_LINK;
+    STORE_RELEASE(sq_tail_, tail + count);
+
+    unsigned submitted{};
+    unsigned completed{};
+    while (completed < count) {
+        const int result = IO_URING_ENTER(fd_, count - submitted, count - completed, IORING_ENTER_GETEVENTS);
+        if (result < 0) {
+            if (errno == EINTR)
+                continue;
+            throw std::system_error(errno, std::system_category(), "io_uring_enter");
+        }
+        submitted += static_cast<unsigned>(result);
+
+        unsigned head = *cq_head_;
+        const unsigned ready = LOAD_ACQUIRE(cq_tail_);
+        for (; head != ready; head++) {
+            const io_uring_cqe& cqe = static_cast<const io_uring_cqe*>(cqes_)[head & *cq_mask_];
+            if (cqe.user_data < count)
+                results_[cqe.user_data] = cqe.res;
+            completed++;
+        }
+        STORE_RELEASE(cq_head_, head);
+    }
+
+    std::size_t sent{};
+    while (sent < count && results_[sent] >= 0 && static_cast<std::uint32_t>(results_[sent]) == sizes_[sent])
+        sent++;
+
+    if (sent == 0 && results_[0] < 0)
+        throw std::system_error(-results_[0], std::system_category(), "send");
+
+    return sent;
+}
+
+void LEDriver::IoRing::close_() noexcept {
+    if (sqes_)
+        ::munmap(sqes_, sqes_size_);
+    if (cq_ring_ && cq_ring_ != sq_ring_)
+        ::munmap(cq_ring_, cq_ring_size_);
+    if (sq_ring_)
+        ::munmap(sq_ring_, sq_ring_size_);
+    if (fd_ >= 0)
+        ::close(fd_);
+
+    sqes_ = nullptr;
+    cq_ring_ = nullptr;
+    sq_ring_ = nullptr;
+    fd_ = -1;
+}
@@ -0,0 +1,105 @@
+/*!
+    \file
+    \brief Header containing `IoRing` class, a minimal io_uring instance used for batched UDP sends.
+    \copyright Copyright (c) 2026 Wiktor Sołtys
+    \cond
+        See LICENSE
+    \endcond
+*/
+#pragma once
+
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <sys/socket.h>
+
+namespace LEDriver {
+
+/*!
+    \brief A non-copyable io_uring instance with a table of fixed files, sending datagrams in linked batches.
+
+    Only built with the `LEDRIVER_IO_URING` CMake option on Linux. The kernel interface is used directly, so liburing
+    is not required. `ControllerGroup` sends its batches with one `io_uring_enter()` call per ring-full of frames:
+    sends from the fixed files are linked into one chain, so a failed send cancels the rest of the batch, just like
+    a short `sendmmsg()`.
+
+    Requires Linux 6.0 (destination address of `IORING_OP_SEND`). Registered buffers are not used: the kernel accepts
+    them only for zero-copy sends, which cost an extra notification per datagram, more than copying a few bytes.
+*/
+class IoRing {
+  public:
+    /*!
+        \brief Create the ring and register an empty table of fixed files.
+
+        \param entries - maximum number of sends per batch, a power of two.
+        \param files - size of the fixed file table.
+
+        \throw std::system_error
+               - `EINVAL` when `entries` is not a power of two or `files` is zero
+               - `ENOSYS`, `EPERM` and other errors of `io_uring_setup()` when io_uring is unavailable
+               - `EOPNOTSUPP` when the kernel does not support addressed sends
+    */
+    IoRing(unsigned entries, unsigned files);
+
+    IoRing(const IoRing&) = delete;
+    IoRing& operator=(const IoRing&) = delete;
+    ~IoRing() noexcept;
+
+    //! \return Maximum number of sends per batch.
+    unsigned entries() const noexcept;
+
+    /*!
+        \brief Put a socket at the index `index` of the fixed file table, replacing the previous one.
+               The ring holds its own reference, closing `fd` does not remove it from the table.
+
+        \throw std::system_error - errors of `io_uring_register()`
+    */
+    void set_file(unsigned index, int fd);
+
+    /*!
+        \brief Queue a send of `size` bytes at `data` from the fixed file `file` to address `to`. Nothing is submitted
+               until `IoRing::submit()`, both `data` and `to` must stay valid until then. At most `IoRing::entries()`
+               sends can be queued.
+    */
+    void prepare_send(const void* data, std::size_t size, unsigned file, const sockaddr_storage& to) noexcept;
+
+    /*!
+        \brief Submit queued sends and wait for all of them to complete.
+
+        \return Number of leading sends which completed in full, in the order they were queued.
+
+        \throw std::system_error - error of the first send, when no send completed
+    */
+    std::size_t submit();
+
+  private:
+    int fd_{-1};
+    unsigned entries_{};
+
+    void* sq_ring_{};
+    std::size_t sq_ring_size_{};
+    void* cq_ring_{};
+    std::size_t cq_ring_size_{};
+    void* sqes_{};
+    std::size_t sqes_size_{};
+
+    // Pointers into the mapped rings.
+    unsigned* sq_tail_{};
+    unsigned* sq_mask_{};
+    unsigned* sq_array_{};
+    unsigned* cq_head_{};
+    unsigned* cq_tail_{};
+    unsigned* cq_mask_{};
+    void* cqes_{};
+
+    // Sends queued since the last submit, with their sizes, and results of the ones completed.
+    unsigned queued_{};
+    std::vector<std::uint32_t> sizes_;
+    std::vector<std::int32_t> results_;
+
+    void close_() noexcept;
+};
+
+} // namespace LEDriver
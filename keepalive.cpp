@@ -0,0 +1,129 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stop_token>
+#include <system_error>
+#include <utility>
+
+#include <cerrno>
+#include <cstddef>
+
+#include <event_loop.hpp>
+#include <keepalive.hpp>
+#include <ledriver.hpp>
+
+LEDriver::Keepalive::Keepalive(std::chrono::milliseconds interval, std::size_t misses)
+    : interval_(interval), misses_(misses) {
+    if (interval.count() <= 0 || misses == 0)
+        throw std::system_error(EINVAL, std::generic_category());
+}
+
+LEDriver::Keepalive::~Keepalive() noexcept {
+    stop();
+}
+
+std::size_t LEDriver::Keepalive::add(Controller& ctl) {
+    if (running())
+        throw std::system_error(EBUSY, std::generic_category());
+
+    slots_.emplace_back().ctl = &ctl;
+    return slots_.size() - 1;
+}
+
+bool LEDriver::Keepalive::is_up(std::size_t id) const noexcept {
+    return slots_[id].up.load(std::memory_order_acquire);
+}
+
+void LEDriver::Keepalive::start(StateCallback on_change) {
+    if (running())
+        return;
+
+    thread_ = std::jthread([this, on_change = std::move(on_change)](std::stop_token stop) {
+        auto next = std::chrono::steady_clock::now();
+
+        while (!stop.stop_requested()) {
+            round_(on_change);
+
+            // Rounds which cannot keep up are skipped rather than sent in a burst.
+            next += interval_;
+            const auto now = std::chrono::steady_clock::now();
+            if (next < now)
+                next = now;
+
+            // Collect replies until the next round, in slices short enough to notice a stop request.
+            while (!stop.stop_requested()) {
+                const auto left = std::chrono::ceil<std::chrono::milliseconds>(next - std::chrono::steady_clock::now());
+                if (left.count() <= 0)
+                    break;
+
+                if (loop_.pending() == 0) {
+                    std::unique_lock lock(wait_mutex_);
+                    wait_cv_.wait_until(lock, stop, next, [] { return false; });
+                    break;
+                }
+
+                try {
+                    loop_.run_once(std::min(left, stop_check_interval));
+                } catch (const std::system_error&) {
+                    // The failed wait is retried, requests still time out in the next rounds.
+                }
+            }
+        }
+
+        // Pending PINGs refer to this thread's callbacks.
+        for (Slot& slot : slots_) {
+            loop_.cancel(*slot.ctl);
+            slot.pending = false;
+        }
+    });
+}
+
+void LEDriver::Keepalive::stop() noexcept {
+    if (!thread_.joinable())
+        return;
+
+    thread_.request_stop();
+    thread_.join();
+}
+
+bool LEDriver::Keepalive::running() const noexcept {
+    return thread_.joinable();
+}
+
+void LEDriver::Keepalive::round_(const StateCallback& on_change) {
+    for (std::size_t id = 0; id < slots_.size(); id++) {
+        Slot& slot = slots_[id];
+
+        // A PING still pending after a whole interval counts as a miss.
+        if (slot.pending) {
+            loop_.cancel(*slot.ctl);
+            slot.pending = false;
+            result_(id, false, on_change);
+        }
+
+        try {
+            loop_.ping(*slot.ctl, [this, id, &on_change](bool pong, std::chrono::nanoseconds) {
+                slots_[id].pending = false;
+                result_(id, pong, on_change);
+            });
+            slot.pending = true;
+        } catch (const std::system_error&) {
+            result_(id, false, on_change);
+        }
+    }
+}
+
+void LEDriver::Keepalive::result_(std::size_t id, bool pong, const StateCallback& on_change) {
+    Slot& slot = slots_[id];
+    const bool was_up = slot.up.load(std::memory_order_relaxed);
+
+    slot.misses = pong ? 0 : slot.misses + 1;
+    const bool up = pong || (was_up && slot.misses < misses_);
+    if (up == was_up)
+        return;
+
+    slot.up.store(up, std::memory_order_release);
+    if (on_change)
+        on_change(id, up);
+}
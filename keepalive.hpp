@@ -0,0 +1,120 @@
+/*!
+    \file
+    \brief Header containing `Keepalive` class, pinging controllers in the background to tell which drivers are up.
+    \copyright Copyright (c) 2026 Wiktor Sołtys
+    \cond
+        See LICENSE
+    \endcond
+*/
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include <cstddef>
+
+#include <event_loop.hpp>
+#include <ledriver.hpp>
+
+namespace LEDriver {
+
+/*!
+    \brief Pings registered controllers every `interval` from a background thread and marks the drivers up or down.
+
+    A driver is up after a PONG and down after `misses` PINGs in a row without one. Until the first result it is
+    down. A control loop checks `Keepalive::is_up()`, which is lock-free, and skips drivers that are down instead of
+    blocking on them.
+
+    PINGs are sent through an `EventLoop`, so they all wait at once and each fails after the reply timeout of its
+    controller. Adaptive timeouts (see `Controller::set_adaptive_timeout()`) are fed by these round trips. A PING
+    still pending at the next interval counts as a miss.
+
+    While the keepalive runs, registered controllers must not be used for blocking `Controller::ping()`,
+    `Controller::status()` or `Controller::sync_clock()` calls, other methods can be used from any thread.
+*/
+class Keepalive {
+  public:
+    /*!
+        Called from the keepalive thread when a driver goes up or down.
+
+        \param id - identifier returned by `Keepalive::add()`.
+        \param up - new state of the driver.
+    */
+    using StateCallback = std::function<void(std::size_t id, bool up)>;
+
+    /*!
+        Create a stopped keepalive.
+
+        \param interval - time between two PINGs of a driver.
+        \param misses - number of PINGs in a row without a PONG which mark a driver down.
+
+        \throw std::system_error
+               - `EINVAL` when `interval` is not positive or `misses` is zero
+               - system errors
+    */
+    explicit Keepalive(std::chrono::milliseconds interval = std::chrono::milliseconds(1000), std::size_t misses = 3);
+
+    Keepalive(const Keepalive&) = delete;
+    Keepalive& operator=(const Keepalive&) = delete;
+    ~Keepalive() noexcept;
+
+    /*!
+        \brief Register a controller. Must not be called while the keepalive is running.
+
+        \return Identifier of the controller used with `Keepalive::is_up()`.
+
+        \throw std::system_error
+               - `EBUSY` when the keepalive is running
+    */
+    std::size_t add(Controller& ctl);
+
+    //! \return `true` when the driver answered its last PINGs. Lock-free, can be called from any thread.
+    bool is_up(std::size_t id) const noexcept;
+
+    /*!
+        \brief Start the keepalive thread.
+
+        \param on_change - called when a driver goes up or down, may be empty.
+    */
+    void start(StateCallback on_change = {});
+
+    //! Stop the keepalive thread. Pending PINGs are dropped, the states stay as they are.
+    void stop() noexcept;
+
+    //! \return `true` when the keepalive thread is running.
+    bool running() const noexcept;
+
+  private:
+    //! Longest wait for replies before checking whether the thread has been stopped.
+    static constexpr std::chrono::milliseconds stop_check_interval{20};
+
+    struct Slot {
+        Controller* ctl;
+        std::atomic<bool> up{};
+        std::size_t misses{};
+        bool pending{};
+    };
+
+    std::chrono::milliseconds interval_;
+    std::size_t misses_;
+
+    // `std::deque` keeps slots in place as it grows, atomics cannot be moved.
+    std::deque<Slot> slots_;
+    EventLoop loop_;
+
+    // Lets `Keepalive::stop()` interrupt the wait between rounds.
+    std::mutex wait_mutex_;
+    std::condition_variable_any wait_cv_;
+
+    std::jthread thread_;
+
+    void round_(const StateCallback& on_change);
+    void result_(std::size_t id, bool pong, const StateCallback& on_change);
+};
+
+} // namespace LEDriver
@@ -1,9 +1,9 @@
+#include <array>
 #include <chrono>
 #include <limits>
 #include <sys/types.h>
 #include <system_error>
 #include <utility>
-#include <vector>
 
 #include <cerrno>
 #include <cstddef>
@@ -14,37 +14,19 @@
     #include <ws2tcpip.h>
 
     #pragma comment(lib, "Ws2_32.lib")
-
-    #define GET_SOCKET_ERROR() ::WSAGetLastError()
 #else
     #include <arpa/inet.h>
     #include <sys/socket.h>
     #include <sys/time.h>
     #include <sys/uio.h>
     #include <unistd.h>
-
-    #define GET_SOCKET_ERROR() errno
 #endif
 
 #include <ledriver.hpp>
+#include <metrics.hpp>
+#include <shared_socket.hpp>
 #include <tools.hpp>
 
-#if defined(_WIN32)
-namespace {
-struct WSAInit {
-    WSAInit() {
-        WSADATA w{};
-        if (const int result = ::WSAStartup(MAKEWORD(2, 2), &w); result != 0)
-            throw std::system_error(result, std::system_category(), "WSAStartup");
-    }
-
-    ~WSAInit() {
-        ::WSACleanup();
-    }
-};
-} // namespace
-#endif
-
 bool LEDriver::ColorState::operator==(const ColorState& other) const noexcept {
     return r == other.r && g == other.g && b == other.b;
 }
@@ -59,18 +41,18 @@ LEDriver::Controller::Controller(const sockaddr_storage& addr, std::chrono::mill
         throw std::system_error(EINVAL, std::generic_category());
 
     // If windows, initialize winsock.
-#if defined(_WIN32)
-    static WSAInit wsa;
-#endif
+    INIT_SOCKETS();
+
+    addr_ = addr;
+    timeout_ = timeout;
 
     // Create UDP socket.
     fd_ = ::socket(addr.ss_family, SOCK_DGRAM, 0);
     if (fd_ == invalid_socket)
         throw std::system_error(GET_SOCKET_ERROR(), std::system_category(), "socket");
 
-    // Use `connect()` on UDP, so we don't need to keep server address.
-    if (::connect(fd_, reinterpret_cast<const sockaddr*>(&addr),
-                  addr.ss_family == AF_INET ? sizeof(sockaddr_in) : sizeof(sockaddr_in6)) != 0) {
+    // Use `connect()` on UDP, so plain send/recv can be used and only driver datagrams are received.
+    if (::connect(fd_, reinterpret_cast<const sockaddr*>(&addr), SOCKADDR_LEN(addr)) != 0) {
         close();
         throw std::system_error(GET_SOCKET_ERROR(), std::system_category(), "connect");
     }
@@ -105,14 +87,57 @@ LEDriver::Controller::Controller(const sockaddr_storage& addr, std::chrono::mill
 #endif
 }
 
-LEDriver::Controller::Controller(Controller&& other) noexcept : fd_(std::exchange(other.fd_, invalid_socket)) {}
+LEDriver::Controller::Controller(std::shared_ptr<SharedSocket> socket, const sockaddr_storage& addr,
+                                 std::chrono::milliseconds timeout) {
+    if (!socket)
+        throw std::system_error(EINVAL, std::generic_category());
+
+    // Checks the address family as well.
+    socket->attach_(addr);
+
+    fd_ = socket->fd_;
+    addr_ = addr;
+    shared_ = std::move(socket);
+    timeout_ = timeout;
+}
+
+LEDriver::Controller::Controller(Controller&& other) noexcept {
+    *this = std::move(other);
+}
 
 LEDriver::Controller& LEDriver::Controller::operator=(Controller&& other) noexcept {
     if (this == &other)
         return *this;
 
+    constexpr auto relaxed = std::memory_order_relaxed;
+
     close();
     fd_ = std::exchange(other.fd_, invalid_socket);
+    addr_ = other.addr_;
+    shared_ = std::move(other.shared_);
+    timeout_ = other.timeout_;
+    sequence_.store(other.sequence_.load(relaxed), relaxed);
+    metrics_.store(other.metrics_.load(relaxed), relaxed);
+
+    // Carry the caches over, so a relocated controller keeps deduplicating. The moved-from one starts afresh.
+    color_state_cache_.store(other.color_state_cache_.exchange(0, relaxed), relaxed);
+    power_state_cache_.store(other.power_state_cache_.exchange(power_unknown, relaxed), relaxed);
+    clock_offset_.store(other.clock_offset_.exchange(clock_unsynced, relaxed), relaxed);
+    status_cache_.store(other.status_cache_.exchange(0, relaxed), relaxed);
+    color_time_.store(other.color_time_.exchange(0, relaxed), relaxed);
+    power_time_.store(other.power_time_.exchange(0, relaxed), relaxed);
+    pixel_cache_ = std::move(other.pixel_cache_);
+    other.pixel_cache_.clear();
+    frames_since_keyframe_ = std::exchange(other.frames_since_keyframe_, 0);
+    fade_from_.store(other.fade_from_.load(relaxed), relaxed);
+    fade_start_.store(other.fade_start_.load(relaxed), relaxed);
+    fade_shape_.store(other.fade_shape_.load(relaxed), relaxed);
+    fade_target_.store(other.fade_target_.exchange(color_unknown, relaxed), relaxed);
+    srtt_.store(other.srtt_.exchange(0, relaxed), relaxed);
+    rttvar_.store(other.rttvar_.exchange(0, relaxed), relaxed);
+    backoff_.store(other.backoff_.exchange(0, relaxed), relaxed);
+    rto_min_.store(other.rto_min_.load(relaxed), relaxed);
+    rto_max_.store(other.rto_max_.load(relaxed), relaxed);
 
     return *this;
 }
@@ -125,6 +150,14 @@ void LEDriver::Controller::close() noexcept {
     if (fd_ == invalid_socket)
         return;
 
+    // The shared socket is closed when the last controller detaches.
+    if (shared_) {
+        shared_->detach_(addr_);
+        shared_.reset();
+        fd_ = invalid_socket;
+        return;
+    }
+
 #if defined(_WIN32)
     ::closesocket(fd_);
 #else
@@ -134,80 +167,128 @@ void LEDriver::Controller::close() noexcept {
     fd_ = invalid_socket;
 }
 
+void LEDriver::Controller::set_metrics(Metrics* metrics) noexcept {
+    metrics_.store(metrics, std::memory_order_release);
+}
+
+LEDriver::Metrics* LEDriver::Controller::metrics() const noexcept {
+    return metrics_.load(std::memory_order_acquire);
+}
+
 bool LEDriver::Controller::is_valid() const noexcept {
     return fd_ != invalid_socket;
 }
 
+const sockaddr_storage& LEDriver::Controller::address() const noexcept {
+    return addr_;
+}
+
 LEDriver::Controller::operator bool() const noexcept {
     return is_valid();
 }
 
-void LEDriver::Controller::send_(const std::vector<std::span<const std::byte>>& data) {
+void LEDriver::Controller::send_(std::span<const std::span<const std::byte>> data) {
     if (!is_valid())
         throw std::system_error(ENOTCONN, std::generic_category());
 
-    if (data.empty())
+    if (data.empty() || data.size() > max_frame_segments)
         throw std::system_error(EINVAL, std::generic_category());
 
+    TraceScope trace(false);
     std::size_t to_send{};
 
+    // Segment descriptors live on the stack, so sending a frame never allocates.
 #if defined(_WIN32)
-    if (data.size() > (std::numeric_limits<DWORD>::max)())
-        throw std::system_error(EINVAL, std::generic_category());
-
-    std::vector<WSABUF> segments;
-    for (const auto& segment : data) {
-        if (segment.size() > (std::numeric_limits<decltype(WSABUF::len)>::max)())
+    std::array<WSABUF, max_frame_segments> segments{};
+    for (std::size_t i = 0; i < data.size(); i++) {
+        if (data[i].size() > (std::numeric_limits<decltype(WSABUF::len)>::max)())
             throw std::system_error(EINVAL, std::generic_category());
 
-        WSABUF buffer{};
-        buffer.buf = reinterpret_cast<CHAR*>(const_cast<std::byte*>(segment.data()));
-        buffer.len = static_cast<decltype(WSABUF::len)>(segment.size());
-        segments.push_back(buffer);
-        to_send += segment.size();
+        segments[i].buf = reinterpret_cast<CHAR*>(const_cast<std::byte*>(data[i].data()));
+        segments[i].len = static_cast<decltype(WSABUF::len)>(data[i].size());
+        to_send += data[i].size();
     }
 
     if (to_send == 0)
         throw std::system_error(EINVAL, std::generic_category());
 
+    // A shared socket is not connected, so address the frame to the driver.
+    const sockaddr* to = shared_ ? reinterpret_cast<const sockaddr*>(&addr_) : nullptr;
+    const int to_len = shared_ ? static_cast<int>(SOCKADDR_LEN(addr_)) : 0;
+
     DWORD sent;
-    if (WSASend(fd_, segments.data(), static_cast<DWORD>(segments.size()), &sent, 0, nullptr, nullptr) == SOCKET_ERROR)
-        throw std::system_error(GET_SOCKET_ERROR(), std::system_category(), "WSASend");
+    trace.enter();
+    if (WSASendTo(fd_, segments.data(), static_cast<DWORD>(data.size()), &sent, 0, to, to_len, nullptr, nullptr) ==
+        SOCKET_ERROR)
+        throw std::system_error(GET_SOCKET_ERROR(), std::system_category(), "WSASendTo");
 
     if (static_cast<std::size_t>(sent) != to_send)
         throw std::system_error(EIO, std::generic_category());
 #else
-    std::vector<iovec> segments;
-    for (const auto& segment : data) {
-        if (segment.size() > (std::numeric_limits<decltype(iovec::iov_len)>::max)())
+    std::array<iovec, max_frame_segments> segments{};
+    for (std::size_t i = 0; i < data.size(); i++) {
+        if (data[i].size() > (std::numeric_limits<decltype(iovec::iov_len)>::max)())
             throw std::system_error(EINVAL, std::generic_category());
 
-        iovec buffer{};
-        buffer.iov_base = static_cast<void*>(const_cast<std::byte*>(segment.data()));
-        buffer.iov_len = static_cast<decltype(iovec::iov_len)>(segment.size());
-        segments.push_back(buffer);
-        to_send += segment.size();
+        segments[i].iov_base = static_cast<void*>(const_cast<std::byte*>(data[i].data()));
+        segments[i].iov_len = static_cast<decltype(iovec::iov_len)>(data[i].size());
+        to_send += data[i].size();
     }
 
     if (to_send == 0)
         throw std::system_error(EINVAL, std::generic_category());
 
-    const msghdr hdr{.msg_iov = segments.data(), .msg_iovlen = segments.size()};
+    // A shared socket is not connected, so address the frame to the driver.
+    msghdr hdr{.msg_iov = segments.data(), .msg_iovlen = data.size()};
+    if (shared_) {
+        hdr.msg_name = &addr_;
+        hdr.msg_namelen = SOCKADDR_LEN(addr_);
+    }
+
+    trace.enter();
     const ssize_t result = ::sendmsg(fd_, &hdr, 0);
     if (result < 0)
         throw std::system_error(GET_SOCKET_ERROR(), std::system_category(), "sendmsg");
     else if (static_cast<std::size_t>(result) != to_send)
         throw std::system_error(EIO, std::generic_category());
 #endif
+
+    trace.exit(data[0], to_send);
+
+    // The action is the 6th byte of the header, which is always the first segment.
+    if (Metrics* metrics = metrics_.load(std::memory_order_acquire);
+        metrics && data[0].size() >= sizeof(RootHeader))
+        metrics->sent_(static_cast<std::uint8_t>(data[0][offsetof(RootHeader, action)]), to_send);
 }
 
-std::size_t LEDriver::Controller::recv_(std::span<std::byte> data) {
+std::size_t LEDriver::Controller::recv_(std::span<std::byte> data, std::chrono::milliseconds timeout) {
     if (!is_valid())
         throw std::system_error(ENOTCONN, std::generic_category());
 
     if (data.empty())
         throw std::system_error(EINVAL, std::generic_category());
 
+    TraceScope trace(true);
+
+    // Replies on a shared socket are routed by source address. The traced call covers the routed wait.
+    if (shared_) {
+        trace.enter();
+        std::chrono::steady_clock::time_point arrival;
+        const std::size_t size = shared_->recv_(addr_, data, timeout, arrival);
+        trace.arrive(arrival);
+        trace.exit(data, size);
+        return size;
+    }
+
+    // The socket's receive timeout covers a single wait only, a shorter limit is enforced here.
+    if (timeout.count() > 0) {
+        if (!WAIT_READABLE(fd_, timeout))
+            throw std::system_error(TIMEOUT_ERROR(), std::system_category(), "recv");
+        trace.arrive();
+    }
+
+    trace.enter();
+
 #if defined(_WIN32)
     if (data.size() > (std::numeric_limits<int>::max)())
         throw std::system_error(EINVAL, std::generic_category());
@@ -221,6 +302,122 @@ std::size_t LEDriver::Controller::recv_(std::span<std::byte> data) {
         throw std::system_error(GET_SOCKET_ERROR(), std::system_category(), "recv");
 #endif
 
+    trace.exit(data, static_cast<std::size_t>(result));
+
     // Return the number of bytes received.
     return static_cast<std::size_t>(result);
 }
+
+std::size_t LEDriver::Controller::recv_reply_(const RootHeader& request, std::span<std::byte> data) {
+    const auto timeout = reply_timeout();
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+
+    while (true) {
+        std::chrono::milliseconds left{};
+        if (timeout.count() > 0) {
+            left = std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+            if (left.count() <= 0) {
+                rtt_timeout_();
+                if (Metrics* metrics = metrics_.load(std::memory_order_acquire))
+                    metrics->timeouts_.fetch_add(1, std::memory_order_relaxed);
+                throw std::system_error(TIMEOUT_ERROR(), std::system_category(), "recv");
+            }
+        }
+
+        std::size_t size;
+        try {
+            size = recv_(data, left);
+        } catch (const std::system_error& se) {
+            if (IS_TIMEOUT(se.code().value())) {
+                rtt_timeout_();
+                if (Metrics* metrics = metrics_.load(std::memory_order_acquire))
+                    metrics->timeouts_.fetch_add(1, std::memory_order_relaxed);
+            }
+            throw;
+        }
+
+        if (size < sizeof(RootHeader))
+            continue;
+
+        // Drop stale replies to earlier requests and datagrams which are not replies to this one.
+        RootHeader reply;
+        std::memcpy(&reply, data.data(), sizeof(reply));
+
+        const std::uint16_t mask = SERIALIZE_U16(RootHeader::sequence_mask);
+        if (reply.magic == request.magic && reply.version == request.version && reply.action == request.action &&
+            (reply.flags & mask) == (request.flags & mask))
+            return size;
+    }
+}
+
+std::uint16_t LEDriver::Controller::next_sequence_() noexcept {
+
+    // Sequence 0 is left for requests without a reply.
+    const std::uint16_t sequence = sequence_.fetch_add(1, std::memory_order_relaxed);
+    return static_cast<std::uint16_t>(sequence % RootHeader::sequence_mask + 1);
+}
+
+bool LEDriver::Controller::claim_color_(std::uint64_t packed, std::uint64_t& previous) noexcept {
+
+    // Concurrent callers with the same color must not send it again, so the change is claimed before sending.
+    previous = color_state_cache_.load(std::memory_order_relaxed);
+    do {
+        if (previous == packed) {
+            if (Metrics* metrics = metrics_.load(std::memory_order_acquire))
+                metrics->deduped_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+    } while (!color_state_cache_.compare_exchange_weak(previous, packed, std::memory_order_acq_rel,
+                                                       std::memory_order_relaxed));
+
+    // A new color ends the fade in the driver, and so its mirror, even if the fade target is sent again later.
+    if (fade_target_.load(std::memory_order_relaxed) != color_unknown)
+        fade_target_.store(color_unknown, std::memory_order_release);
+
+    return true;
+}
+
+void LEDriver::Controller::unclaim_color_(std::uint64_t packed, std::uint64_t previous) noexcept {
+    color_state_cache_.compare_exchange_strong(packed, previous, std::memory_order_acq_rel, std::memory_order_relaxed);
+}
+
+bool LEDriver::Controller::claim_power_(std::uint8_t state, std::uint8_t& previous) noexcept {
+    previous = power_state_cache_.load(std::memory_order_relaxed);
+    do {
+        if (previous == state) {
+            if (Metrics* metrics = metrics_.load(std::memory_order_acquire))
+                metrics->deduped_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+    } while (!power_state_cache_.compare_exchange_weak(previous, state, std::memory_order_acq_rel,
+                                                       std::memory_order_relaxed));
+
+    return true;
+}
+
+void LEDriver::Controller::unclaim_power_(std::uint8_t state, std::uint8_t previous) noexcept {
+    power_state_cache_.compare_exchange_strong(state, previous, std::memory_order_acq_rel, std::memory_order_relaxed);
+}
+
+void LEDriver::Controller::cache_status_(std::uint64_t bits, std::uint64_t mask) noexcept {
+    std::uint64_t cached = status_cache_.load(std::memory_order_relaxed);
+    while (!status_cache_.compare_exchange_weak(cached, (cached & ~mask) | bits, std::memory_order_release,
+                                                std::memory_order_relaxed))
+        ;
+
+    const auto now = std::chrono::steady_clock::now().time_since_epoch().count();
+    if (mask & status_color_known)
+        color_time_.store(now, std::memory_order_release);
+    if (mask & status_power_known)
+        power_time_.store(now, std::memory_order_release);
+}
+
+void LEDriver::Controller::cache_color_(const ColorState& state) noexcept {
+    cache_status_(PACK_COLOR(state) | status_color_known, status_color_mask | status_color_known);
+}
+
+void LEDriver::Controller::cache_status_(const Status& status) noexcept {
+    cache_status_(PACK_COLOR(status.color) | (status.power ? status_power_bit : 0) | status_color_known |
+                      status_power_known,
+                  ~std::uint64_t{0});
+}
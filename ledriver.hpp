@@ -8,7 +8,12 @@
 */
 #pragma once
 
+#include <atomic>
 #include <chrono>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <span>
 #include <vector>
 
@@ -37,7 +42,34 @@ enum class Action : std::uint8_t {
                    //!< See `Controller::ping()`.
     UPDATE = 0x02, //!< Update LED state. See `Controller::update()`.
     POWER = 0x03,  //!< Turn the driver ON/OFF.
-    STATUS = 0x04  //!< Get driver status (current color and power state).
+    STATUS = 0x04, //!< Get driver status (current color and power state).
+    UPDATE_PIXELS = 0x05, //!< Update a range of pixels of an addressable strip. See `Controller::update_pixels()`.
+    SET_STATE = 0x06,     //!< Set color (3 * u16) and power state (u8) at once. See `Controller::set_state()`.
+    FADE = 0x07           //!< Fade from the current color to a target one, interpolated by the driver.
+                          //!< See `Controller::fade_to()`.
+};
+
+/*!
+    Easing curve of a fade, applied to the progress `t` (from 0 to 1) of the fade: the color at `t` is
+    `from + (to - from) * curve(t)` per channel.
+*/
+enum class FadeCurve : std::uint8_t {
+    LINEAR = 0x00,     //!< `t`
+    EASE_IN = 0x01,    //!< `t^2`, starts slowly.
+    EASE_OUT = 0x02,   //!< `1 - (1 - t)^2`, ends slowly.
+    EASE_IN_OUT = 0x03 //!< `3t^2 - 2t^3` (smoothstep), starts and ends slowly.
+};
+
+/*!
+    Priority class of the datagrams of a socket, set with `Controller::set_priority()` and
+    `ControllerGroup::set_priority()`. Mapped to the DSCP field of the IP header and, on Linux, to `SO_PRIORITY`,
+    which selects the band of the default queueing discipline. Marking has no effect on Windows, which requires the
+    QoS API for it.
+*/
+enum class Priority : std::uint8_t {
+    NORMAL = 0x00, //!< Best effort, unmarked (DSCP CS0).
+    BULK = 0x01,   //!< High-rate color streams (DSCP AF11, `TC_PRIO_BULK`).
+    CONTROL = 0x02 //!< Rare, latency-critical frames, e.g. a blackout (DSCP EF, `TC_PRIO_INTERACTIVE`).
 };
 
 //! `RootHeader` is the main header of each frame used in driver-client communication.
@@ -45,10 +77,41 @@ struct RootHeader {
     std::uint32_t magic;  //!< Magic value. See `RootHeader::magic_value`.
     std::uint8_t version; //!< Protocol version. See `RootHeader::protocol_version`.
     std::uint8_t action;  //!< Action opcode. See `LEDriver::Action`.
-    std::uint16_t flags;  //!< Header flags. Currently not in use yet.
+    std::uint16_t flags;  //!< Header flags: request sequence number and option bits. See `RootHeader::sequence_mask`.
 
     static constexpr std::uint32_t magic_value = 0x4C454452; //!< `"LEDR"`
-    static constexpr std::uint8_t protocol_version = 0x00;   //!< unstable/dev version
+    static constexpr std::uint8_t protocol_version = 0x01;   //!< unstable/dev version with sequence numbers
+
+    /*!
+        Bits of `flags` carrying the request sequence number. The driver copies `flags` of a request into its reply,
+        so the client can match replies with requests and drop stale ones. Requests without a reply may use 0.
+        Remaining bits are reserved for option flags.
+    */
+    static constexpr std::uint16_t sequence_mask = 0x0FFF;
+
+    /*!
+        Option flag of UPDATE_PIXELS: the payload is a list of ranges instead of a single one. Each range is a u16
+        offset and a u16 count followed by `count` pixels, or, when the top bit of count (`RootHeader::run_bit`) is
+        set, by one pixel repeated `count & ~run_bit` times.
+    */
+    static constexpr std::uint16_t flag_ranges = 0x1000;
+
+    //! Marks a run-length encoded range in the count of an UPDATE_PIXELS range. See `RootHeader::flag_ranges`.
+    static constexpr std::uint16_t run_bit = 0x8000;
+
+    /*!
+        Option flag of UPDATE and PING: the header is followed by a u64 timestamp of the driver clock, in microseconds
+        and net endian. An UPDATE frame is applied when the driver clock reaches the timestamp (at once when it has
+        passed), the PING request carries no timestamp and its reply carries the driver clock at the time of reply.
+        See `Controller::sync_clock()` and `Controller::update_at()`.
+    */
+    static constexpr std::uint16_t flag_timestamp = 0x2000;
+
+    /*!
+        Option flag of UPDATE, POWER, SET_STATE and FADE: the driver acknowledges the frame, after applying it, by
+        echoing its header (with the same `flags`) as an 8-byte reply. See `EventLoop::update()`.
+    */
+    static constexpr std::uint16_t flag_ack = 0x4000;
 };
 
 //! Contains RGB state.
@@ -71,7 +134,21 @@ struct Status {
     bool power;       //!< Driver ON/OFF.
 };
 
-//! A move-only class that allows connectionless (UDP) communication with the driver.
+class ControllerArray;
+class ControllerGroup;
+class EventLoop;
+class Metrics;
+class SharedSocket;
+
+/*!
+    \brief A move-only class that allows connectionless (UDP) communication with the driver.
+
+    Except for construction, assignment and `Controller::close()`, methods can be called from many threads at once.
+    State changes (`Controller::update()`, `Controller::power()` and the like) are serialized by a short lock held
+    while one is claimed in the caches and sent, so the driver receives concurrent changes in the order the caches
+    record them and the caches never disagree with the driver. Request/reply exchanges (`Controller::ping()`,
+    `Controller::status()`) are serialized by another lock, so every caller gets its own reply.
+*/
 class Controller {
   public:
     //! Create an empty, invalid Controller.
@@ -87,13 +164,29 @@ class Controller {
     explicit Controller(const sockaddr_storage& addr,
                         std::chrono::milliseconds timeout = std::chrono::milliseconds(1000));
 
+    /*!
+        Attach to a UDP socket shared with other controllers instead of opening a dedicated one.
+        See `SharedSocket`.
+
+        \param socket - shared socket. Its address family must match the driver address.
+        \param addr - IPv4/IPv6 address of the driver.
+        \param timeout - time in ms after which no response from the driver indicates a network error/no contact.
+                         Affects methods that require a response from the controller, e.g. `Controller::ping()`.
+
+        \throw std::system_error
+               - `EINVAL` when socket is null or its family does not match the address
+    */
+    Controller(std::shared_ptr<SharedSocket> socket, const sockaddr_storage& addr,
+               std::chrono::milliseconds timeout = std::chrono::milliseconds(1000));
+
+    //! Move the socket and all cached state (color, power, status, pixels, fade, clock offset) to a new Controller.
     Controller(Controller&&) noexcept;
     Controller& operator=(Controller&&) noexcept;
     Controller(const Controller&) = delete;
     Controller& operator=(const Controller&) = delete;
     ~Controller() noexcept;
 
-    //! Close the socket and set the Controller status to closed.
+    //! Close the socket (or detach from the shared one) and set the Controller status to closed.
     void close() noexcept;
 
     /*!
@@ -103,6 +196,8 @@ class Controller {
         \return `false` when the driver does not return PONG within the `timeout` specified in the constructor, or the
                 PONG frame is incorrect.
 
+        Replies to earlier requests which arrive late are dropped.
+
         \throw std::system_error
                - `ENOTCONN` when Controller is not valid (closed)
                - `EIO` when server response has invalid size
@@ -122,8 +217,125 @@ class Controller {
     */
     void update(const ColorState& state);
 
+    //! Maximum number of pixels carried by a single UPDATE_PIXELS frame, so the frame fits in one Ethernet MTU.
+    static constexpr std::size_t max_pixels_per_frame = 240;
+
+    /*!
+        \brief Schedule a color update applied by the driver at the time `at`. The driver does not return any
+               response. Like `Controller::update()`, nothing is sent when the color state persists.
+
+        Sending timestamped frames to many drivers ahead of `at` makes them all change at the same instant,
+        regardless of the order the frames are sent in. Requires `Controller::sync_clock()`.
+
+        \param state - color state. See `ColorState`.
+        \param at - local time of presentation, converted to the driver clock with the estimated offset.
+
+        \throw std::system_error
+               - `ENOTCONN` when Controller is not valid (closed)
+               - `EINVAL` when the clock has not been synchronized
+               - system network layer errors
+    */
+    void update_at(const ColorState& state, std::chrono::steady_clock::time_point at);
+
+    /*!
+        \brief Estimate the offset between the driver clock and `std::chrono::steady_clock` with timestamped PING
+               round trips (see `RootHeader::flag_timestamp`).
+
+        Each sample assumes the driver read its clock halfway through the round trip. The sample with the shortest
+        round trip is the least affected by queueing delays and is kept, so its round-trip time bounds the error.
+
+        \param samples - number of round trips.
+
+        \return Round-trip time of the sample used.
+
+        \throw std::system_error
+               - `ENOTCONN` when Controller is not valid (closed)
+               - `EINVAL` when `samples` is 0
+               - `ETIMEDOUT` (`WSAETIMEDOUT` on Windows) when no sample got a reply within the `timeout`
+               - `EIO` when replies carry no timestamp (the driver does not support `RootHeader::flag_timestamp`)
+               - system network layer errors
+    */
+    std::chrono::nanoseconds sync_clock(std::size_t samples = 8);
+
+    //! \return `true` when the clock has been synchronized with `Controller::sync_clock()`.
+    bool clock_synced() const noexcept;
+
+    /*!
+        \brief Convert local time to the driver clock, in microseconds.
+
+        \throw std::system_error - `EINVAL` when the clock has not been synchronized
+    */
+    std::uint64_t to_driver_time(std::chrono::steady_clock::time_point time) const;
+
+    /*!
+        \brief Fade to the color `target` over `duration`. The driver interpolates locally, so the whole fade takes
+               one datagram. The driver does not return any response. The frame is always sent.
+
+        The fade starts from the color the driver shows at the time, which may be an intermediate color of an
+        earlier fade. `Controller::cached_status()` mirrors the fade and predicts the color at the time of the call.
+        A later color change (e.g. `Controller::update()`) ends the mirrored fade, as it ends the fade in the driver.
+
+        \param target - color state at the end of the fade. See `ColorState`.
+        \param duration - length of the fade. Zero sets the color at once.
+        \param curve - easing curve. See `FadeCurve`.
+
+        \throw std::system_error
+               - `ENOTCONN` when Controller is not valid (closed)
+               - `EINVAL` when `duration` is negative or longer than 2^32 - 1 ms
+               - system network layer errors
+    */
+    void fade_to(const ColorState& target, std::chrono::milliseconds duration, FadeCurve curve = FadeCurve::LINEAR);
+
+    /*!
+        \brief Update pixels of an addressable strip in the driver. The driver does not return any response.
+               Pixels are packed `Controller::max_pixels_per_frame` per datagram, e.g. a 300-pixel strip takes two.
+
+        \param pixels - color states of consecutive pixels. See `ColorState`.
+        \param offset - index of the first updated pixel.
+
+        \throw std::system_error
+               - `ENOTCONN` when Controller is not valid (closed)
+               - `EINVAL` when the range exceeds 65536 pixels
+               - system network layer errors
+    */
+    void update_pixels(std::span<const ColorState> pixels, std::uint16_t offset = 0);
+
+    /*!
+        \brief Update pixels from an already serialized buffer, e.g. filled by `ColorTransform`. Pixels are sent
+               straight from the buffer, without copying. See `Controller::update_pixels()`.
+
+        \param pixels - 6 bytes per pixel: r, g and b as u16 in net endian.
+        \param offset - index of the first updated pixel.
+
+        \throw std::system_error
+               - `ENOTCONN` when Controller is not valid (closed)
+               - `EINVAL` when the buffer does not hold whole pixels or the range exceeds 65536 pixels
+               - system network layer errors
+    */
+    void update_pixels(std::span<const std::byte> pixels, std::uint16_t offset = 0);
+
     /*!
-        \brief Turn the driver ON/OFF.
+        \brief Update the whole strip, sending only the pixels changed since the previous call. Changed ranges are
+               sent in as few datagrams as possible, with runs of equal pixels run-length encoded.
+               See `RootHeader::flag_ranges`.
+
+        Frames are not acknowledged by the driver, so every `keyframe_interval`-th call sends all pixels, as does the
+        first call and a call with a different strip length. Pixels of a lost datagram are repaired by the next key
+        frame.
+
+        \param pixels - color states of all pixels of the strip. See `ColorState`.
+        \param keyframe_interval - number of calls between two key frames. 0 disables periodic key frames.
+
+        \throw std::system_error
+               - `ENOTCONN` when Controller is not valid (closed)
+               - `EINVAL` when the strip is longer than 65536 pixels
+               - system network layer errors
+    */
+    void update_pixels_delta(std::span<const ColorState> pixels, std::size_t keyframe_interval = 100);
+
+    /*!
+        \brief Turn the driver ON/OFF. The driver does not return any response.
+               If the power state persists since the last call, nothing is sent.
 
         \param state - ON = `true`, OFF = `false`.
 
@@ -133,20 +345,123 @@ class Controller {
     */
     void power(bool state);
 
+    /*!
+        \brief Set color and power state of the driver. The driver does not return any response.
+
+        Sends only what has changed since the last call of `Controller::update()`, `Controller::power()` or this method:
+        a single SET_STATE frame when both have changed, an UPDATE or POWER frame when only one has, nothing otherwise.
+
+        \param state - color and power state. See `Status`.
+
+        \throw std::system_error
+               - `ENOTCONN` when Controller is not valid (closed)
+               - system network layer errors
+    */
+    void set_state(const Status& state);
+
     /*!
         \brief Get driver status.
 
         \return `Status` object containing current color and power state. See `Status`.
 
+        Replies to earlier requests which arrive late are dropped.
+
         \throw std::system_error
                - `ENOTCONN` when Controller is not valid (closed)
+               - `EIO` when server response has invalid size
+               - `ETIMEDOUT` (`WSAETIMEDOUT` on Windows) when there is no reply within the `timeout`
                - system network layer errors
     */
     Status status();
 
+    /*!
+        \brief Get driver status, from the status cache when it is fresh enough. See `Controller::cached_status()`.
+
+        \param max_age - maximum age of a cached status. When the cache is older or incomplete, the driver is queried
+                         as by `Controller::status()`, which refreshes the cache.
+
+        \return `Status` object containing current color and power state. See `Status`.
+
+        \throw std::system_error - as `Controller::status()`, when the driver is queried
+    */
+    Status status(std::chrono::milliseconds max_age);
+
+    /*!
+        \brief Get the last known driver status without any network traffic.
+
+        The cache is written by STATUS replies (including those of `EventLoop`) and by the state sent with
+        `Controller::update()`, `Controller::power()` and `ControllerGroup`, which the driver does not confirm. The
+        color and the power state age separately, each since its last write, and the cache is as old as the older of
+        them: e.g. `Controller::update()` does not make an old power state look fresh.
+
+        \param max_age - maximum age of the cached status.
+
+        \return Cached status, or empty when the color or the power state is not known yet or the cache is older than
+                `max_age`.
+    */
+    std::optional<Status> cached_status(std::chrono::milliseconds max_age) const noexcept;
+
+    /*!
+        \brief Count the traffic of this Controller in `metrics`. See `Metrics`.
+
+        \param metrics - counters to update, may be shared by many controllers. Must outlive the Controller, or be
+                         detached first. `nullptr` detaches.
+    */
+    void set_metrics(Metrics* metrics) noexcept;
+
+    //! \return Counters attached with `Controller::set_metrics()`, or `nullptr`.
+    Metrics* metrics() const noexcept;
+
+    /*!
+        \brief Mark datagrams sent by this Controller with a priority class. See `Priority`.
+
+        Frames of a `ControllerGroup` (and so of `FrameScheduler`) go out of the group's own sockets, so marking the
+        Controller with `Priority::CONTROL` lets `Controller::power()` and `Controller::status()` bypass bulk color
+        traffic in the host's queues. On a `SharedSocket` the mark applies to all its controllers.
+
+        \param priority - priority class.
+
+        \throw std::system_error
+               - `ENOTCONN` when Controller is not valid (closed)
+               - system network layer errors
+    */
+    void set_priority(Priority priority);
+
+    /*!
+        \brief Derive the reply timeout of `Controller::ping()`, `Controller::status()` and `EventLoop` requests from
+               measured round trips, instead of the fixed `timeout` given in the constructor.
+
+        Round trips are smoothed as in TCP (RFC 6298): the timeout is SRTT + 4 * RTTVAR, at least SRTT + 1 ms, clamped
+        to [`min`, `max`]. Every expired timeout doubles it (up to `max`) until the next reply. Before the first round
+        trip the constructor `timeout` is used, or `max` when it is zero, clamped the same way.
+
+        \param min - lower bound of the timeout.
+        \param max - upper bound of the timeout.
+
+        \throw std::system_error
+               - `EINVAL` when `min` is not positive or `max` is less than `min`
+    */
+    void set_adaptive_timeout(std::chrono::milliseconds min = std::chrono::milliseconds(20),
+                              std::chrono::milliseconds max = std::chrono::milliseconds(3000));
+
+    //! Return to the fixed `timeout` given in the constructor. Measured round trips are kept.
+    void disable_adaptive_timeout() noexcept;
+
+    //! \return Timeout of the next request/reply exchange. See `Controller::set_adaptive_timeout()`.
+    std::chrono::milliseconds reply_timeout() const noexcept;
+
+    //! \return Smoothed round trip time of PING and STATUS exchanges, zero until the first one completes.
+    std::chrono::nanoseconds srtt() const noexcept;
+
+    //! \return Round trip time variation, zero until the first exchange completes.
+    std::chrono::nanoseconds rttvar() const noexcept;
+
     //! \return `true` when Controller is valid (not closed).
     bool is_valid() const noexcept;
 
+    //! \return Address of the driver given in the constructor.
+    const sockaddr_storage& address() const noexcept;
+
     /*!
         \brief Alias for `Controller::is_valid()`.
         \return `true` when Controller is valid (not closed).
@@ -154,6 +469,11 @@ class Controller {
     explicit operator bool() const noexcept;
 
   private:
+    friend class ControllerArray;
+    friend class ControllerGroup;
+    friend class EventLoop;
+    friend class SharedSocket;
+
 #if defined(_WIN32)
     using socket_t = SOCKET;
     static constexpr socket_t invalid_socket = INVALID_SOCKET;
@@ -163,11 +483,112 @@ class Controller {
 #endif
 
     socket_t fd_{invalid_socket};
+    sockaddr_storage addr_{};
+
+    // Set when `fd_` is borrowed from a shared socket.
+    std::shared_ptr<SharedSocket> shared_;
+    std::chrono::milliseconds timeout_{};
+
+    // Last color sent to the driver, packed with `PACK_COLOR()`, or `color_unknown`.
+    std::atomic<std::uint64_t> color_state_cache_{};
+    static constexpr std::uint64_t color_unknown = ~std::uint64_t{0};
+
+    // Last power state sent to the driver: 0 (OFF), 1 (ON) or `power_unknown`.
+    std::atomic<std::uint8_t> power_state_cache_{power_unknown};
+    static constexpr std::uint8_t power_unknown = 0xFF;
+
+    std::atomic<std::uint16_t> sequence_{};
+
+    // Driver clock minus local clock in microseconds, `clock_unsynced` until `Controller::sync_clock()`.
+    static constexpr std::int64_t clock_unsynced = std::numeric_limits<std::int64_t>::min();
+    std::atomic<std::int64_t> clock_offset_{clock_unsynced};
+
+    // Last known driver status, packed with `PACK_COLOR()` and the bits below, and the times its color and its power
+    // state were written at (`std::chrono::steady_clock` ticks). See `Controller::cache_status_()`.
+    std::atomic<std::uint64_t> status_cache_{};
+    std::atomic<std::chrono::steady_clock::rep> color_time_{};
+    std::atomic<std::chrono::steady_clock::rep> power_time_{};
+
+    static constexpr std::uint64_t status_color_mask = 0xFFFF'FFFF'FFFF;
+    static constexpr std::uint64_t status_power_bit = std::uint64_t{1} << 48;
+    static constexpr std::uint64_t status_color_known = std::uint64_t{1} << 49;
+    static constexpr std::uint64_t status_power_known = std::uint64_t{1} << 50;
+
+    // Mirror of the last fade, see `Controller::fade_to()`. `fade_target_` is written last and read first: it is
+    // `color_unknown` while there is no fade, and the fade has ended once `color_state_cache_` differs from it.
+    // `fade_from_` is `color_unknown` when the starting color was not known. `fade_shape_` packs the duration in
+    // milliseconds (low 32 bits) and the curve.
+    std::atomic<std::uint64_t> fade_target_{color_unknown};
+    std::atomic<std::uint64_t> fade_from_{color_unknown};
+    std::atomic<std::chrono::steady_clock::rep> fade_start_{};
+    std::atomic<std::uint64_t> fade_shape_{};
+
+    // Optional counters, see `Controller::set_metrics()`.
+    std::atomic<Metrics*> metrics_{};
+
+    // Round trip estimator in nanoseconds (`srtt_` is 0 until the first sample) and the number of doublings of the
+    // timeout since the last reply. Bounds of the adaptive timeout in milliseconds, `rto_max_` is 0 when disabled.
+    std::atomic<std::int64_t> srtt_{};
+    std::atomic<std::int64_t> rttvar_{};
+    std::atomic<std::uint8_t> backoff_{};
+    std::atomic<std::int64_t> rto_min_{};
+    std::atomic<std::int64_t> rto_max_{};
+
+    // Held for the whole request/reply exchange.
+    std::mutex exchange_mutex_;
+
+    // Held while a state change is claimed in the caches and sent, so both see changes in the same order.
+    std::mutex state_mutex_;
+
+    // Strip state last sent by `Controller::update_pixels_delta()`.
+    std::mutex pixels_mutex_;
+    std::vector<ColorState> pixel_cache_;
+    std::size_t frames_since_keyframe_{};
+
+    //! Maximum number of segments a single frame can be gathered from. See `Controller::send_()`.
+    static constexpr std::size_t max_frame_segments = 4;
+
+    //! Send a frame gathered from a fixed number of segments without touching the heap.
+    template <std::size_t N> void send_(const std::span<const std::byte> (&data)[N]) {
+        static_assert(N > 0 && N <= max_frame_segments, "Invalid number of frame segments");
+        send_(std::span<const std::span<const std::byte>>(data));
+    }
+
+    void send_(std::span<const std::span<const std::byte>> data);
+    std::size_t recv_(std::span<std::byte> data, std::chrono::milliseconds timeout);
+    std::size_t recv_reply_(const RootHeader& request, std::span<std::byte> data);
+    std::uint16_t next_sequence_() noexcept;
+
+    //! Claim sending the color `packed`. \return `false` when it is the last sent one. See `Controller::update()`.
+    bool claim_color_(std::uint64_t packed, std::uint64_t& previous) noexcept;
+
+    //! Roll back a claimed color after a failed send, unless another caller has changed it in the meantime.
+    void unclaim_color_(std::uint64_t packed, std::uint64_t previous) noexcept;
+
+    //! Claim sending the power state. \return `false` when it is the last sent one.
+    bool claim_power_(std::uint8_t state, std::uint8_t& previous) noexcept;
+
+    //! Roll back a claimed power state after a failed send.
+    void unclaim_power_(std::uint8_t state, std::uint8_t previous) noexcept;
+
+    //! Replace the `mask` bits of the status cache with `bits` and restart the age of the fields they cover.
+    void cache_status_(std::uint64_t bits, std::uint64_t mask) noexcept;
+
+    //! Cache the color state sent to the driver.
+    void cache_color_(const ColorState& state) noexcept;
+
+    //! Cache the whole status reported by the driver.
+    void cache_status_(const Status& status) noexcept;
+
+    //! \return Color predicted from the mirrored fade at `now`: `std::nullopt` when there is no fade, `color_unknown`
+    //!         when its starting color is not known.
+    std::optional<std::uint64_t> fade_color_(std::chrono::steady_clock::time_point now) const noexcept;
 
-    ColorState color_state_cache_;
+    //! Feed a measured round trip to the estimator and reset the backoff.
+    void rtt_sample_(std::chrono::nanoseconds rtt) noexcept;
 
-    void send_(const std::vector<std::span<const std::byte>>& data);
-    std::size_t recv_(std::span<std::byte> data);
+    //! Double the adaptive timeout after an expired one.
+    void rtt_timeout_() noexcept;
 };
 
 } // namespace LEDriver
\ No newline at end of file
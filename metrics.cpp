@@ -0,0 +1,78 @@
+#include <algorithm>
+#include <bit>
+#include <chrono>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <ledriver.hpp>
+#include <metrics.hpp>
+
+namespace {
+
+constexpr auto relaxed = std::memory_order_relaxed;
+
+} // namespace
+
+LEDriver::MetricsSnapshot LEDriver::Metrics::snapshot() const noexcept {
+    MetricsSnapshot snapshot;
+
+    for (std::size_t i = 0; i < frames_.size(); i++)
+        snapshot.frames[i] = frames_[i].load(relaxed);
+    snapshot.bytes = bytes_.load(relaxed);
+    snapshot.deduped = deduped_.load(relaxed);
+
+    for (std::size_t i = 0; i < MetricsSnapshot::rtt_buckets; i++) {
+        snapshot.ping_rtt[i] = ping_rtt_[i].load(relaxed);
+        snapshot.status_rtt[i] = status_rtt_[i].load(relaxed);
+    }
+    snapshot.ping_rtt_sum = std::chrono::nanoseconds(ping_rtt_sum_.load(relaxed));
+    snapshot.status_rtt_sum = std::chrono::nanoseconds(status_rtt_sum_.load(relaxed));
+
+    snapshot.timeouts = timeouts_.load(relaxed);
+    snapshot.short_replies = short_replies_.load(relaxed);
+    snapshot.retransmits = retransmits_.load(relaxed);
+    snapshot.undelivered = undelivered_.load(relaxed);
+
+    return snapshot;
+}
+
+void LEDriver::Metrics::reset() noexcept {
+    for (Counter& counter : frames_)
+        counter.store(0, relaxed);
+    bytes_.store(0, relaxed);
+    deduped_.store(0, relaxed);
+
+    for (std::size_t i = 0; i < MetricsSnapshot::rtt_buckets; i++) {
+        ping_rtt_[i].store(0, relaxed);
+        status_rtt_[i].store(0, relaxed);
+    }
+    ping_rtt_sum_.store(0, relaxed);
+    status_rtt_sum_.store(0, relaxed);
+
+    timeouts_.store(0, relaxed);
+    short_replies_.store(0, relaxed);
+    retransmits_.store(0, relaxed);
+    undelivered_.store(0, relaxed);
+}
+
+void LEDriver::Metrics::sent_(std::uint8_t action, std::size_t bytes) noexcept {
+    frames_[action % MetricsSnapshot::action_slots].fetch_add(1, relaxed);
+    bytes_.fetch_add(bytes, relaxed);
+}
+
+void LEDriver::Metrics::rtt_(Action action, std::chrono::nanoseconds rtt) noexcept {
+    const auto ns = static_cast<std::uint64_t>(std::max<std::chrono::nanoseconds::rep>(rtt.count(), 0));
+    const std::uint64_t us = ns / 1000;
+
+    // Bucket `i` holds round trips in [2^(i-1), 2^i) microseconds, so its index is the bit width of the value.
+    const std::size_t bucket = std::min<std::size_t>(std::bit_width(us), MetricsSnapshot::rtt_buckets - 1);
+
+    if (action == Action::PING) {
+        ping_rtt_[bucket].fetch_add(1, relaxed);
+        ping_rtt_sum_.fetch_add(ns, relaxed);
+    } else if (action == Action::STATUS) {
+        status_rtt_[bucket].fetch_add(1, relaxed);
+        status_rtt_sum_.fetch_add(ns, relaxed);
+    }
+}
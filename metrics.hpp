@@ -0,0 +1,99 @@
+/*!
+    \file
+    \brief Header containing `Metrics` class, lock-free counters of the traffic of one or many controllers.
+    \copyright Copyright (c) 2026 Wiktor Sołtys
+    \cond
+        See LICENSE
+    \endcond
+*/
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <ledriver.hpp>
+
+namespace LEDriver {
+
+//! Counters of `Metrics` copied at one point in time. Plain values, ready to be exported, e.g. to Prometheus.
+struct MetricsSnapshot {
+
+    //! Number of action slots, indexed by the `Action` value.
+    static constexpr std::size_t action_slots = 16;
+
+    /*!
+        Number of round-trip-time histogram buckets. Bucket `i` counts round trips shorter than
+        `MetricsSnapshot::bucket_bound(i)` and not shorter than the bound of bucket `i - 1`. The last bucket counts
+        everything longer.
+    */
+    static constexpr std::size_t rtt_buckets = 24;
+
+    //! \return Exclusive upper bound of the round-trip-time bucket `i`: 2^i microseconds.
+    static constexpr std::chrono::microseconds bucket_bound(std::size_t i) noexcept {
+        return std::chrono::microseconds(std::int64_t{1} << i);
+    }
+
+    std::array<std::uint64_t, action_slots> frames{}; //!< Frames sent, per action.
+    std::uint64_t bytes{};                            //!< Bytes sent, headers included.
+    std::uint64_t deduped{};                          //!< Frames suppressed because the color or power state persists.
+
+    std::array<std::uint64_t, rtt_buckets> ping_rtt{};   //!< PING round-trip-time histogram.
+    std::array<std::uint64_t, rtt_buckets> status_rtt{}; //!< STATUS round-trip-time histogram.
+    std::chrono::nanoseconds ping_rtt_sum{};              //!< Sum of all PING round trips.
+    std::chrono::nanoseconds status_rtt_sum{};            //!< Sum of all STATUS round trips.
+
+    std::uint64_t timeouts{};      //!< Requests without a reply within the timeout.
+    std::uint64_t short_replies{}; //!< Replies of invalid size (`EIO`).
+    std::uint64_t retransmits{};   //!< Retransmissions of acknowledged state changes. See `EventLoop::update()`.
+    std::uint64_t undelivered{};   //!< Acknowledged state changes which failed or were superseded.
+};
+
+/*!
+    \brief Opt-in, lock-free counters of controller traffic.
+
+    Attach to one or many controllers with `Controller::set_metrics()`; every counter is a relaxed atomic, so one
+    object can aggregate a whole fleet. Frames sent by `ControllerGroup` and requests of `EventLoop` are counted
+    under the controller they are sent for.
+*/
+class Metrics {
+  public:
+    Metrics() noexcept = default;
+    Metrics(const Metrics&) = delete;
+    Metrics& operator=(const Metrics&) = delete;
+
+    //! \return Current values of all counters. Counters updated concurrently may be slightly out of step.
+    MetricsSnapshot snapshot() const noexcept;
+
+    //! Zero all counters.
+    void reset() noexcept;
+
+  private:
+    friend class Controller;
+    friend class ControllerGroup;
+    friend class EventLoop;
+
+    using Counter = std::atomic<std::uint64_t>;
+
+    std::array<Counter, MetricsSnapshot::action_slots> frames_{};
+    Counter bytes_{};
+    Counter deduped_{};
+
+    std::array<Counter, MetricsSnapshot::rtt_buckets> ping_rtt_{};
+    std::array<Counter, MetricsSnapshot::rtt_buckets> status_rtt_{};
+    Counter ping_rtt_sum_{};
+    Counter status_rtt_sum_{};
+
+    Counter timeouts_{};
+    Counter short_replies_{};
+    Counter retransmits_{};
+    Counter undelivered_{};
+
+    void sent_(std::uint8_t action, std::size_t bytes) noexcept;
+    void rtt_(Action action, std::chrono::nanoseconds rtt) noexcept;
+};
+
+} // namespace LEDriver
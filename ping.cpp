@@ -1,15 +1,21 @@
+#include <chrono>
+
 #include <ledriver.hpp>
+#include <metrics.hpp>
 #include <tools.hpp>
 
 bool LEDriver::Controller::ping() {
     if (!is_valid())
         throw std::system_error(ENOTCONN, std::generic_category());
 
-    RootHeader ping_header{}, pong_header;
-    ping_header.magic = SERIALIZE_U32(RootHeader::magic_value);
-    ping_header.version = RootHeader::protocol_version;
-    ping_header.action = SERIALIZE_ACTION(Action::PING);
-    ping_header.flags = 0;
+    // Keep concurrent exchanges from reading each other's replies.
+    const std::lock_guard lock(exchange_mutex_);
+
+    const RootHeader ping_header = MAKE_HEADER(Action::PING, next_sequence_());
+    RootHeader pong_header;
+
+    Metrics* metrics = metrics_.load(std::memory_order_acquire);
+    const auto sent = std::chrono::steady_clock::now();
 
     // Send PING frame to driver.
     send_({TO_CIOV(ping_header)});
@@ -17,25 +23,29 @@ bool LEDriver::Controller::ping() {
     try {
 
         // Wait for a PONG frame from the server.
-        if (recv_({TO_IOV(pong_header)}) != sizeof(RootHeader))
+        if (recv_reply_(ping_header, TO_IOV(pong_header)) != sizeof(RootHeader)) {
+            if (metrics)
+                metrics->short_replies_.fetch_add(1, std::memory_order_relaxed);
             throw std::system_error(EIO, std::generic_category());
+        }
 
     } catch (const std::system_error& se) {
 
         // If the recv error is due to timeout, return false.
-        const int code = se.code().value();
-#if defined(_WIN32)
-        if (code == WSAETIMEDOUT || code == WSAEWOULDBLOCK)
+        if (IS_TIMEOUT(se.code().value()))
             return false;
-#else
-        if (code == ETIMEDOUT || code == EWOULDBLOCK || code == EAGAIN)
-            return false;
-#endif
 
         throw;
     }
 
+    const auto rtt = std::chrono::steady_clock::now() - sent;
+
     // PING and PONG frames must be the same.
-    return ping_header.magic == pong_header.magic && ping_header.version == pong_header.version &&
-           ping_header.action == pong_header.action && ping_header.flags == pong_header.flags;
+    if (!IS_PONG(ping_header, pong_header))
+        return false;
+
+    rtt_sample_(rtt);
+    if (metrics)
+        metrics->rtt_(Action::PING, rtt);
+    return true;
 }
\ No newline at end of file
@@ -5,12 +5,24 @@ void LEDriver::Controller::power(bool state) {
     if (!is_valid())
         throw std::system_error(ENOTCONN, std::generic_category());
 
-    RootHeader power_header{};
-    power_header.magic = SERIALIZE_U32(RootHeader::magic_value);
-    power_header.version = RootHeader::protocol_version;
-    power_header.action = SERIALIZE_ACTION(Action::POWER);
-    power_header.flags = 0;
+    const std::lock_guard lock(state_mutex_);
+
+    // If the power state persists, do not send.
+    const std::uint8_t value = state ? 0x01 : 0x00;
+    std::uint8_t previous;
+    if (!claim_power_(value, previous))
+        return;
 
     // POWER action requires u8 value, containing 0x00 (OFF) or 0x01 (ON).
-    send_({TO_CIOV(power_header), TO_CIOV(static_cast<std::uint8_t>(state))});
+    auto frame = POWER_FRAME;
+    frame.set<0>(state);
+
+    try {
+        send_({frame.data()});
+        cache_status_(state ? status_power_bit | status_power_known : status_power_known,
+                      status_power_bit | status_power_known);
+    } catch (...) {
+        unclaim_power_(value, previous);
+        throw;
+    }
 }
\ No newline at end of file
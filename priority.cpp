@@ -0,0 +1,23 @@
+#include <system_error>
+
+#include <cerrno>
+
+#include <group.hpp>
+#include <ledriver.hpp>
+#include <tools.hpp>
+
+void LEDriver::Controller::set_priority(Priority priority) {
+    if (!is_valid())
+        throw std::system_error(ENOTCONN, std::generic_category());
+
+    SET_PRIORITY(fd_, addr_.ss_family, priority);
+}
+
+void LEDriver::ControllerGroup::set_priority(Priority priority) {
+    if (fd4_ != invalid_socket)
+        SET_PRIORITY(fd4_, AF_INET, priority);
+    if (fd6_ != invalid_socket)
+        SET_PRIORITY(fd6_, AF_INET6, priority);
+
+    priority_ = priority;
+}
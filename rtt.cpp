@@ -0,0 +1,85 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <system_error>
+
+#include <cerrno>
+#include <cstdint>
+
+#include <ledriver.hpp>
+
+namespace {
+
+constexpr auto relaxed = std::memory_order_relaxed;
+
+//! The timeout is doubled no more than this many times, `max` caps it anyway.
+constexpr std::uint8_t max_backoff = 16;
+
+} // namespace
+
+void LEDriver::Controller::set_adaptive_timeout(std::chrono::milliseconds min, std::chrono::milliseconds max) {
+    if (min.count() <= 0 || max < min)
+        throw std::system_error(EINVAL, std::generic_category());
+
+    rto_min_.store(min.count(), relaxed);
+    rto_max_.store(max.count(), std::memory_order_release);
+}
+
+void LEDriver::Controller::disable_adaptive_timeout() noexcept {
+    rto_max_.store(0, std::memory_order_release);
+}
+
+std::chrono::milliseconds LEDriver::Controller::reply_timeout() const noexcept {
+    const std::int64_t max = rto_max_.load(std::memory_order_acquire);
+    if (max == 0)
+        return timeout_;
+
+    const std::int64_t min = rto_min_.load(relaxed);
+    const std::int64_t srtt = srtt_.load(relaxed);
+
+    std::int64_t timeout;
+    if (srtt == 0) {
+        timeout = timeout_.count() > 0 ? timeout_.count() : max;
+    } else {
+        // RTO = SRTT + max(G, 4 * RTTVAR) with a clock granularity G of 1 ms, rounded up to whole milliseconds.
+        const std::int64_t rto = srtt + std::max<std::int64_t>(1'000'000, 4 * rttvar_.load(relaxed));
+        timeout = (rto + 999'999) / 1'000'000;
+    }
+
+    timeout = std::clamp(timeout, min, max);
+    for (std::uint8_t i = backoff_.load(relaxed); i > 0 && timeout < max; i--)
+        timeout *= 2;
+
+    return std::chrono::milliseconds(std::min(timeout, max));
+}
+
+std::chrono::nanoseconds LEDriver::Controller::srtt() const noexcept {
+    return std::chrono::nanoseconds(srtt_.load(relaxed));
+}
+
+std::chrono::nanoseconds LEDriver::Controller::rttvar() const noexcept {
+    return std::chrono::nanoseconds(rttvar_.load(relaxed));
+}
+
+void LEDriver::Controller::rtt_sample_(std::chrono::nanoseconds rtt) noexcept {
+    const std::int64_t sample = std::max<std::int64_t>(rtt.count(), 1);
+    const std::int64_t srtt = srtt_.load(relaxed);
+
+    // Samples from concurrent exchanges may overwrite each other, which only drops one of them.
+    if (srtt == 0) {
+        rttvar_.store(sample / 2, relaxed);
+        srtt_.store(sample, relaxed);
+    } else {
+        const std::int64_t deviation = srtt > sample ? srtt - sample : sample - srtt;
+        rttvar_.store((3 * rttvar_.load(relaxed) + deviation) / 4, relaxed);
+        srtt_.store((7 * srtt + sample) / 8, relaxed);
+    }
+
+    backoff_.store(0, relaxed);
+}
+
+void LEDriver::Controller::rtt_timeout_() noexcept {
+    std::uint8_t backoff = backoff_.load(relaxed);
+    if (backoff < max_backoff)
+        backoff_.compare_exchange_strong(backoff, static_cast<std::uint8_t>(backoff + 1), relaxed);
+}
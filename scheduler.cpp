@@ -0,0 +1,194 @@
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <mutex>
+#include <stop_token>
+#include <system_error>
+#include <utility>
+
+#include <cassert>
+#include <cerrno>
+#include <cstddef>
+
+#include <group.hpp>
+#include <ledriver.hpp>
+#include <scheduler.hpp>
+#include <tools.hpp>
+
+LEDriver::FrameScheduler::FrameScheduler(std::chrono::nanoseconds period) noexcept : period_(period) {}
+
+LEDriver::FrameScheduler::~FrameScheduler() noexcept {
+    stop();
+}
+
+std::size_t LEDriver::FrameScheduler::add(Controller& ctl) {
+    if (running())
+        throw std::system_error(EBUSY, std::generic_category());
+
+    slots_.emplace_back().ctl = &ctl;
+    return slots_.size() - 1;
+}
+
+void LEDriver::FrameScheduler::submit(std::size_t id, const ColorState& state) noexcept {
+    assert(id < slots_.size());
+    slots_[id].pending.store(PACK_COLOR(state) | dirty_bit, std::memory_order_release);
+}
+
+void LEDriver::FrameScheduler::submit_power(std::size_t id, bool state) {
+    assert(id < slots_.size());
+    slots_[id].power.store(state ? power_on : power_off, std::memory_order_release);
+
+    // Set under the lock, so the scheduler thread cannot miss it between evaluating the wait condition and sleeping.
+    {
+        const std::lock_guard lock(wait_mutex_);
+        control_pending_.store(true, std::memory_order_release);
+    }
+    wait_cv_.notify_one();
+}
+
+void LEDriver::FrameScheduler::set_priority(Priority priority) {
+    if (running())
+        throw std::system_error(EBUSY, std::generic_category());
+
+    group_.set_priority(priority);
+}
+
+std::size_t LEDriver::FrameScheduler::tick(const ErrorCallback& on_error) {
+    // The group and the control lane belong to the scheduler thread while it runs.
+    if (running())
+        throw std::system_error(EBUSY, std::generic_category());
+
+    return tick_(on_error);
+}
+
+std::size_t LEDriver::FrameScheduler::tick_(const ErrorCallback& on_error) {
+    std::exception_ptr first;
+
+    // Control frames go first, so they never wait behind a batch. A failing one does not hold the colors back.
+    try {
+        send_control_(on_error);
+    } catch (...) {
+        report_(on_error, first);
+    }
+
+    // Take the latest color of every slot written since the last tick.
+    for (Slot& slot : slots_) {
+        if ((slot.pending.load(std::memory_order_relaxed) & dirty_bit) == 0)
+            continue;
+
+        const std::uint64_t pending = slot.pending.exchange(0, std::memory_order_acquire);
+        if ((pending & dirty_bit) == 0 || !slot.ctl->is_valid())
+            continue;
+
+        try {
+            group_.update(*slot.ctl, UNPACK_COLOR(pending));
+        } catch (...) {
+
+            // Keep the color pending unless a newer one has been submitted meanwhile, and go on with the others.
+            std::uint64_t expected = 0;
+            slot.pending.compare_exchange_strong(expected, pending, std::memory_order_relaxed);
+            report_(on_error, first);
+        }
+    }
+
+    // Frames not sent stay queued in the group for the next tick.
+    std::size_t sent{};
+    try {
+        sent = group_.flush();
+    } catch (...) {
+        report_(on_error, first);
+    }
+
+    if (first)
+        std::rethrow_exception(first);
+
+    return sent;
+}
+
+void LEDriver::FrameScheduler::start(ErrorCallback on_error) {
+    if (running())
+        return;
+
+    thread_ = std::jthread([this, on_error = std::move(on_error)](std::stop_token stop) {
+        auto next = std::chrono::steady_clock::now();
+
+        while (!stop.stop_requested()) {
+            // With a callback every error is reported, without one the first error is thrown and dropped here.
+            try {
+                tick_(on_error);
+            } catch (const std::exception&) {
+            }
+
+            // When ticks cannot keep up, skip the missed ones instead of catching up in a burst.
+            next += period_;
+            const auto now = std::chrono::steady_clock::now();
+            if (next < now)
+                next = now;
+
+            // Send control frames submitted meanwhile right away, then keep waiting for the tick.
+            std::unique_lock lock(wait_mutex_);
+            while (wait_cv_.wait_until(lock, stop, next,
+                                       [this] { return control_pending_.load(std::memory_order_acquire); })) {
+                lock.unlock();
+                try {
+                    send_control_(on_error);
+                } catch (const std::exception&) {
+                }
+                lock.lock();
+            }
+        }
+    });
+}
+
+void LEDriver::FrameScheduler::send_control_(const ErrorCallback& on_error) {
+    control_pending_.exchange(false, std::memory_order_acquire);
+
+    std::exception_ptr first;
+    for (Slot& slot : slots_) {
+        if (slot.power.load(std::memory_order_relaxed) == power_none)
+            continue;
+
+        const std::uint8_t power = slot.power.exchange(power_none, std::memory_order_acquire);
+        if (power == power_none || !slot.ctl->is_valid())
+            continue;
+
+        try {
+            slot.ctl->power(power == power_on);
+        } catch (...) {
+
+            // Keep the state pending unless a newer one has been submitted meanwhile, and go on with the others.
+            std::uint8_t expected = power_none;
+            slot.power.compare_exchange_strong(expected, power, std::memory_order_relaxed);
+            report_(on_error, first);
+        }
+    }
+
+    if (first)
+        std::rethrow_exception(first);
+}
+
+void LEDriver::FrameScheduler::report_(const ErrorCallback& on_error, std::exception_ptr& first) {
+    if (!on_error) {
+        if (!first)
+            first = std::current_exception();
+        return;
+    }
+
+    try {
+        throw;
+    } catch (const std::exception& error) {
+        on_error(error);
+    }
+}
+
+void LEDriver::FrameScheduler::stop() noexcept {
+    if (!thread_.joinable())
+        return;
+
+    thread_.request_stop();
+    thread_.join();
+}
+
+bool LEDriver::FrameScheduler::running() const noexcept {
+    return thread_.joinable();
+}
@@ -0,0 +1,176 @@
+/*!
+    \file
+    \brief Header containing `FrameScheduler` class, used to send color updates at a fixed rate.
+    \copyright Copyright (c) 2026 Wiktor Sołtys
+    \cond
+        See LICENSE
+    \endcond
+*/
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <system_error>
+#include <thread>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <group.hpp>
+#include <ledriver.hpp>
+
+namespace LEDriver {
+
+/*!
+    \brief Sends color updates of many controllers at a fixed rate, keeping only the latest value per controller.
+
+    Producers call `FrameScheduler::submit()` from any thread at any rate; it never blocks nor locks. Every `period`
+    the scheduler thread takes the latest submitted colors and sends them as one batch through `ControllerGroup`, so
+    the network load does not depend on how fast producers write.
+
+    Power changes submitted with `FrameScheduler::submit_power()` form a separate control lane: they wake the scheduler
+    thread at once and are sent before any color, from each controller's own socket, so they do not queue behind a
+    batch in the group's socket buffers. Mark the batches with `FrameScheduler::set_priority()` and the controllers
+    with `Controller::set_priority()` to keep them apart in the host's queues and on the network as well.
+
+    Registered controllers are driven by the scheduler thread and must not be updated directly while it runs.
+*/
+class FrameScheduler {
+  public:
+    /*!
+        Called for every error of a tick: a failed power state, color or batch, e.g. `std::system_error` or
+        `std::bad_alloc`. Whatever failed stays pending and is retried on the next tick.
+    */
+    using ErrorCallback = std::function<void(const std::exception& error)>;
+
+    /*!
+        Create a stopped scheduler.
+
+        \param period - time between two consecutive batches, e.g. 10 ms for 100 Hz.
+    */
+    explicit FrameScheduler(std::chrono::nanoseconds period = std::chrono::milliseconds(10)) noexcept;
+
+    FrameScheduler(const FrameScheduler&) = delete;
+    FrameScheduler& operator=(const FrameScheduler&) = delete;
+    ~FrameScheduler() noexcept;
+
+    /*!
+        \brief Register a controller. Must not be called while the scheduler is running.
+
+        \return Identifier of the controller used with `FrameScheduler::submit()`.
+
+        \throw std::system_error
+               - `EBUSY` when the scheduler is running
+    */
+    std::size_t add(Controller& ctl);
+
+    /*!
+        \brief Set the color to be sent with the next batch, replacing a color not sent yet. Lock-free, can be called
+               from any thread.
+
+        \param id - identifier returned by `FrameScheduler::add()`. Not checked, other than by an assertion.
+        \param state - color state. See `ColorState`.
+    */
+    void submit(std::size_t id, const ColorState& state) noexcept;
+
+    /*!
+        \brief Set the power state to be sent ahead of the next colors, replacing a state not sent yet. The scheduler
+               thread is woken to send it right away instead of at the next tick. Can be called from any thread,
+               briefly locks to wake the thread.
+
+        \param id - identifier returned by `FrameScheduler::add()`. Not checked, other than by an assertion.
+        \param state - power state, as `Controller::power()`.
+
+        \throw std::system_error - when locking the wait mutex fails, see `std::mutex::lock()`. The state stays pending
+               and is sent with the next tick.
+    */
+    void submit_power(std::size_t id, bool state);
+
+    /*!
+        \brief Mark the batches of colors with a priority class. See `ControllerGroup::set_priority()`.
+
+        \throw std::system_error
+               - `EBUSY` when the scheduler is running
+               - system network layer errors
+    */
+    void set_priority(Priority priority);
+
+    /*!
+        \brief Send the latest submitted power states, then the latest submitted colors, now. Must not be called while
+               the scheduler is running.
+
+        A failing power state or color does not hold back the others, states and colors not sent stay pending.
+
+        \param on_error - called for every error. Without it, the first error is thrown once the tick has finished.
+
+        \return Number of color frames sent.
+
+        \throw std::system_error
+               - `EBUSY` when the scheduler is running
+               - without `on_error`: the same as `ControllerGroup::update()`, `ControllerGroup::flush()` and
+                 `Controller::power()`
+    */
+    std::size_t tick(const ErrorCallback& on_error = {});
+
+    /*!
+        \brief Start the scheduler thread calling `FrameScheduler::tick()` every `period`. Ticks which cannot keep up
+               are skipped rather than sent in a burst.
+
+        \param on_error - called for every error of a tick, see `FrameScheduler::ErrorCallback`. Without it, errors
+                          are dropped.
+    */
+    void start(ErrorCallback on_error = {});
+
+    //! Stop the scheduler thread. Colors submitted after the last tick stay pending.
+    void stop() noexcept;
+
+    //! \return `true` when the scheduler thread is running.
+    bool running() const noexcept;
+
+  private:
+    //! Set in `Slot::pending` when the slot holds a color not sent yet.
+    static constexpr std::uint64_t dirty_bit = std::uint64_t{1} << 63;
+
+    //! Values of `Slot::power`: no power state pending, or the pending state.
+    static constexpr std::uint8_t power_none = 0x00;
+    static constexpr std::uint8_t power_off = 0x01;
+    static constexpr std::uint8_t power_on = 0x02;
+
+    struct Slot {
+        Controller* ctl;
+        std::atomic<std::uint64_t> pending{};
+        std::atomic<std::uint8_t> power{power_none};
+    };
+
+    std::chrono::nanoseconds period_;
+
+    // `std::deque` keeps slots in place as it grows, atomics cannot be moved.
+    std::deque<Slot> slots_;
+    ControllerGroup group_;
+
+    // Set by `FrameScheduler::submit_power()`, cleared before the control lane is sent.
+    std::atomic<bool> control_pending_{};
+
+    // Lets `FrameScheduler::stop()` interrupt the wait between ticks.
+    std::mutex wait_mutex_;
+    std::condition_variable_any wait_cv_;
+
+    std::jthread thread_;
+
+    //! Body of `FrameScheduler::tick()`, called by the scheduler thread.
+    std::size_t tick_(const ErrorCallback& on_error);
+
+    //! Send pending power states through the controllers. On error, states not sent stay pending for the next tick.
+    //! Errors are reported like by `FrameScheduler::tick()`.
+    void send_control_(const ErrorCallback& on_error);
+
+    //! Report the current exception to `on_error`, or keep it in `first` unless an earlier one is kept already.
+    static void report_(const ErrorCallback& on_error, std::exception_ptr& first);
+};
+
+} // namespace LEDriver
@@ -0,0 +1,47 @@
+#include <ledriver.hpp>
+#include <tools.hpp>
+
+void LEDriver::Controller::set_state(const Status& state) {
+    if (!is_valid())
+        throw std::system_error(ENOTCONN, std::generic_category());
+
+    const std::lock_guard lock(state_mutex_);
+
+    // Claim both changes first, then send only what has changed.
+    const std::uint64_t packed = PACK_COLOR(state.color);
+    const std::uint8_t power_value = state.power ? 0x01 : 0x00;
+    std::uint64_t previous_color;
+    std::uint8_t previous_power;
+    const bool color_changed = claim_color_(packed, previous_color);
+    const bool power_changed = claim_power_(power_value, previous_power);
+
+    try {
+        if (color_changed && power_changed) {
+
+            // SET_STATE action requires 7-byte payload: the channel brightness values (3 * u16) in net endian and
+            // u8 power state, the same as the STATUS reply.
+            auto frame = SET_STATE_FRAME;
+            frame.set<0>(state.color);
+            frame.set<1>(state.power);
+            send_({frame.data()});
+            cache_status_(state);
+        } else if (color_changed) {
+            auto frame = UPDATE_FRAME;
+            frame.set<0>(state.color);
+            send_({frame.data()});
+            cache_color_(state.color);
+        } else if (power_changed) {
+            auto frame = POWER_FRAME;
+            frame.set<0>(state.power);
+            send_({frame.data()});
+            cache_status_(state.power ? status_power_bit | status_power_known : status_power_known,
+                          status_power_bit | status_power_known);
+        }
+    } catch (...) {
+        if (color_changed)
+            unclaim_color_(packed, previous_color);
+        if (power_changed)
+            unclaim_power_(power_value, previous_power);
+        throw;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,227 @@
+#include <algorithm>
+#include <chrono>
+#include <system_error>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+
+#if defined(_WIN32)
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+
+    #pragma comment(lib, "Ws2_32.lib")
+#else
+    #include <sys/socket.h>
+    #include <unistd.h>
+#endif
+
+#include <ledriver.hpp>
+#include <shared_socket.hpp>
+#include <tools.hpp>
+
+bool LEDriver::SharedSocket::AddressLess::operator()(const sockaddr_storage& a,
+                                                      const sockaddr_storage& b) const noexcept {
+    return SOCKADDR_COMPARE(a, b) < 0;
+}
+
+LEDriver::SharedSocket::SharedSocket(int family) : family_(family) {
+
+    // Support only IP4 and IP6.
+    if (family != AF_INET && family != AF_INET6)
+        throw std::system_error(EINVAL, std::generic_category());
+
+    // If windows, initialize winsock.
+    INIT_SOCKETS();
+
+    // Create UDP socket. It stays unconnected, every frame carries the driver address.
+    fd_ = ::socket(family, SOCK_DGRAM, 0);
+    if (fd_ == Controller::invalid_socket)
+        throw std::system_error(GET_SOCKET_ERROR(), std::system_category(), "socket");
+
+    // Replies of many drivers queue up on this socket between two reads. Best effort, the system may cap the size.
+    const int buffer_size = receive_buffer_size;
+    ::setsockopt(fd_, SOL_SOCKET, SO_RCVBUF, reinterpret_cast<const char*>(&buffer_size), sizeof(buffer_size));
+}
+
+LEDriver::SharedSocket::~SharedSocket() noexcept {
+#if defined(_WIN32)
+    ::closesocket(fd_);
+#else
+    ::close(fd_);
+#endif
+}
+
+int LEDriver::SharedSocket::family() const noexcept {
+    return family_;
+}
+
+void LEDriver::SharedSocket::attach_(const sockaddr_storage& addr) {
+    if (addr.ss_family != family_)
+        throw std::system_error(EINVAL, std::generic_category());
+
+    const std::lock_guard lock(mutex_);
+    mailboxes_[addr].refs++;
+}
+
+void LEDriver::SharedSocket::detach_(const sockaddr_storage& addr) noexcept {
+    const std::lock_guard lock(mutex_);
+    const auto it = mailboxes_.find(addr);
+    if (it != mailboxes_.end() && --it->second.refs == 0)
+        mailboxes_.erase(it);
+}
+
+std::size_t LEDriver::SharedSocket::recv_(const sockaddr_storage& addr, std::span<std::byte> data,
+                                          std::chrono::milliseconds timeout,
+                                          std::chrono::steady_clock::time_point& arrival) {
+    if (data.empty())
+        throw std::system_error(EINVAL, std::generic_category());
+
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    const auto timed_out = [&]() {
+        return timeout.count() > 0 && std::chrono::steady_clock::now() >= deadline;
+    };
+
+    std::unique_lock lock(mutex_);
+    Mailbox& own = mailboxes_.at(addr);
+
+    std::byte buffer[max_datagram_size];
+    while (true) {
+
+        // Return a reply read earlier on behalf of this driver.
+        if (!own.datagrams.empty()) {
+            const Datagram& datagram = own.datagrams.front();
+            const std::size_t size = std::min(data.size(), datagram.data.size());
+            std::memcpy(data.data(), datagram.data.data(), size);
+            arrival = datagram.arrival;
+            own.datagrams.pop_front();
+            return size;
+        }
+
+        if (timed_out())
+            throw std::system_error(TIMEOUT_ERROR(), std::system_category(), "recvfrom");
+
+        // Another thread reads the socket, wait until it hands something over.
+        if (reading_) {
+            if (timeout.count() > 0)
+                mailbox_cv_.wait_until(lock, deadline);
+            else
+                mailbox_cv_.wait(lock);
+            continue;
+        }
+
+        reading_ = true;
+        lock.unlock();
+
+        sockaddr_storage source{};
+        std::size_t received{};
+        std::chrono::steady_clock::time_point seen;
+
+        try {
+            if (timeout.count() > 0) {
+                const auto left =
+                    std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+                if (left.count() <= 0 || !WAIT_READABLE(fd_, left))
+                    throw std::system_error(TIMEOUT_ERROR(), std::system_category(), "recvfrom");
+                seen = std::chrono::steady_clock::now();
+            }
+
+            socklen_t source_len = sizeof(source);
+
+#if defined(_WIN32)
+            const int result = ::recvfrom(fd_, reinterpret_cast<CHAR*>(buffer), static_cast<int>(sizeof(buffer)),
+                                          0, reinterpret_cast<sockaddr*>(&source), &source_len);
+            if (result == SOCKET_ERROR)
+                throw std::system_error(GET_SOCKET_ERROR(), std::system_category(), "recvfrom");
+#else
+            const ssize_t result = ::recvfrom(fd_, buffer, sizeof(buffer), 0, reinterpret_cast<sockaddr*>(&source),
+                                              &source_len);
+            if (result < 0)
+                throw std::system_error(GET_SOCKET_ERROR(), std::system_category(), "recvfrom");
+#endif
+
+            received = static_cast<std::size_t>(result);
+
+            // A blocking receive is the first sign of the datagram.
+            if (timeout.count() <= 0)
+                seen = std::chrono::steady_clock::now();
+        } catch (...) {
+
+            // Let a waiting thread take over reading.
+            lock.lock();
+            reading_ = false;
+            mailbox_cv_.notify_all();
+            throw;
+        }
+
+        lock.lock();
+        reading_ = false;
+        mailbox_cv_.notify_all();
+
+        if (SOCKADDR_COMPARE(source, addr) == 0) {
+            const std::size_t size = std::min(data.size(), received);
+            std::memcpy(data.data(), buffer, size);
+            arrival = seen;
+            return size;
+        }
+
+        deposit_(source, {buffer, received}, seen);
+    }
+}
+
+void LEDriver::SharedSocket::deposit_(const sockaddr_storage& source, std::span<const std::byte> data,
+                                      std::chrono::steady_clock::time_point arrival) {
+
+    // Route the datagram to the mailbox of another attached driver, drop it if nobody is waiting for it.
+    const auto it = mailboxes_.find(source);
+    if (it == mailboxes_.end())
+        return;
+
+    if (it->second.datagrams.size() == mailbox_capacity)
+        it->second.datagrams.pop_front();
+    it->second.datagrams.push_back({std::vector<std::byte>(data.begin(), data.end()), arrival});
+    routed_++;
+}
+
+bool LEDriver::SharedSocket::begin_drain_() {
+    const std::lock_guard lock(mutex_);
+    if (reading_)
+        return false;
+
+    reading_ = true;
+    return true;
+}
+
+void LEDriver::SharedSocket::route_(const sockaddr_storage& source, std::span<const std::byte> data,
+                                    std::chrono::steady_clock::time_point arrival) {
+    const std::lock_guard lock(mutex_);
+    deposit_(source, data, arrival);
+}
+
+void LEDriver::SharedSocket::end_drain_() noexcept {
+    const std::lock_guard lock(mutex_);
+
+    // Waiting threads check their mailboxes, one of them takes over reading.
+    reading_ = false;
+    mailbox_cv_.notify_all();
+}
+
+void LEDriver::SharedSocket::collect_(
+    std::uint64_t& routed, const std::function<bool(const sockaddr_storage&, std::span<const std::byte>)>& wanted,
+    std::vector<std::pair<sockaddr_storage, Datagram>>& out) {
+    const std::lock_guard lock(mutex_);
+    if (routed == routed_)
+        return;
+    routed = routed_;
+
+    for (auto& [addr, mailbox] : mailboxes_) {
+        for (auto it = mailbox.datagrams.begin(); it != mailbox.datagrams.end();) {
+            if (wanted(addr, it->data)) {
+                out.emplace_back(addr, std::move(*it));
+                it = mailbox.datagrams.erase(it);
+            } else {
+                it++;
+            }
+        }
+    }
+}
@@ -0,0 +1,127 @@
+/*!
+    \file
+    \brief Header containing `SharedSocket` class, allowing many controllers to share one UDP socket.
+    \copyright Copyright (c) 2026 Wiktor Sołtys
+    \cond
+        See LICENSE
+    \endcond
+*/
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <ledriver.hpp>
+
+namespace LEDriver {
+
+/*!
+    \brief One unconnected UDP socket shared by many controllers.
+
+    Controllers created with `Controller::Controller(std::shared_ptr<SharedSocket>, const sockaddr_storage&,
+    std::chrono::milliseconds)` address their frames to the driver with `sendto()`-style calls and receive replies
+    routed by source address. A reply read by one controller on behalf of another is kept in the other controller's
+    mailbox and returned by its next receive. Datagrams from unknown addresses are dropped.
+
+    Attached controllers can be used from different threads: one thread at a time reads the socket and hands replies
+    over to the others. An `EventLoop` with requests pending on the socket takes part in this handoff, so attached
+    controllers not used with the loop can still make blocking calls.
+
+    Keep it in a `std::shared_ptr`: every attached controller holds a reference.
+*/
+class SharedSocket {
+  public:
+    /*!
+        Create an unconnected UDP socket.
+
+        \param family - `AF_INET` or `AF_INET6`. Only drivers of this family can be attached.
+
+        \throw std::system_error
+               - `EINVAL` when family is not supported
+               - system network layer errors
+    */
+    explicit SharedSocket(int family = AF_INET);
+
+    SharedSocket(const SharedSocket&) = delete;
+    SharedSocket& operator=(const SharedSocket&) = delete;
+    ~SharedSocket() noexcept;
+
+    //! \return Address family of the socket.
+    int family() const noexcept;
+
+  private:
+    friend class Controller;
+    friend class EventLoop;
+
+    //! Maximum number of replies kept per driver before the oldest one is dropped.
+    static constexpr std::size_t mailbox_capacity = 8;
+
+    //! Receive buffer size. Larger datagrams are truncated.
+    static constexpr std::size_t max_datagram_size = 1500;
+
+    //! Requested receive buffer size in bytes.
+    static constexpr int receive_buffer_size = 4 << 20;
+
+    struct AddressLess {
+        bool operator()(const sockaddr_storage& a, const sockaddr_storage& b) const noexcept;
+    };
+
+    struct Datagram {
+        std::vector<std::byte> data;
+        std::chrono::steady_clock::time_point arrival; // Time the datagram was read by the routing thread.
+    };
+
+    struct Mailbox {
+        std::size_t refs{};
+        std::deque<Datagram> datagrams;
+    };
+
+    Controller::socket_t fd_{Controller::invalid_socket};
+    int family_;
+
+    // Guards `mailboxes_`, `reading_` and `routed_`. Threads waiting for a reply while another one reads the socket
+    // wait on `mailbox_cv_`.
+    std::mutex mutex_;
+    std::condition_variable mailbox_cv_;
+    bool reading_{};
+
+    // Number of datagrams routed to mailboxes so far.
+    std::uint64_t routed_{};
+
+    std::map<sockaddr_storage, Mailbox, AddressLess> mailboxes_;
+
+    void attach_(const sockaddr_storage& addr);
+    void detach_(const sockaddr_storage& addr) noexcept;
+    // `arrival` is set to the time the datagram was seen available, by this thread or the one routing it.
+    std::size_t recv_(const sockaddr_storage& addr, std::span<std::byte> data, std::chrono::milliseconds timeout,
+                      std::chrono::steady_clock::time_point& arrival);
+    // Keep the datagram for the attached driver it comes from, if any. Requires `mutex_`.
+    void deposit_(const sockaddr_storage& source, std::span<const std::byte> data,
+                  std::chrono::steady_clock::time_point arrival);
+
+    // Reads by an `EventLoop`. It takes the reader role for one non-blocking drain of the socket; `begin_drain_()`
+    // fails while another thread reads. Datagrams the loop has no request for are handed to `route_()` before
+    // `end_drain_()` returns the role.
+    bool begin_drain_();
+    void route_(const sockaddr_storage& source, std::span<const std::byte> data,
+                std::chrono::steady_clock::time_point arrival);
+    void end_drain_() noexcept;
+
+    // Move the datagrams `wanted` by an `EventLoop` out of the mailboxes into `out`, unless nothing was routed since
+    // `routed`, which is updated.
+    void collect_(std::uint64_t& routed,
+                  const std::function<bool(const sockaddr_storage&, std::span<const std::byte>)>& wanted,
+                  std::vector<std::pair<sockaddr_storage, Datagram>>& out);
+};
+
+} // namespace LEDriver
@@ -0,0 +1,343 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(_WIN32)
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+
+    #include <windows.h>
+
+    #pragma comment(lib, "Ws2_32.lib")
+#else
+    #include <fcntl.h>
+    #include <netinet/in.h>
+    #include <sys/mman.h>
+    #include <sys/socket.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#include <controller_array.hpp>
+#include <ledriver.hpp>
+#include <tools.hpp>
+
+namespace {
+
+// Layout of a snapshot file: a header and `count` records. All integers are in network endian.
+struct SnapshotHeader {
+    std::array<char, 4> magic;
+    std::uint16_t version;
+    std::uint16_t record_size;
+    std::uint32_t count;
+    std::uint32_t reserved;
+};
+
+struct SnapshotRecord {
+    std::uint8_t family; // 4 or 6, as values of `AF_INET6` differ between systems.
+    std::uint8_t reserved;
+    std::uint16_t port;
+    std::uint32_t scope_id;
+    std::array<std::uint8_t, 16> address;
+    std::uint64_t color;       // `Controller::color_state_cache_`.
+    std::uint64_t status;      // `Controller::status_cache_`.
+    std::uint64_t status_time; // Wall clock time of the status cache in ns since the Unix epoch, 0 when never written.
+                               // The older of its color and power state, both are restored as old.
+};
+
+static_assert(sizeof(SnapshotHeader) == 16);
+static_assert(sizeof(SnapshotRecord) == 48);
+
+constexpr std::array<char, 4> snapshot_magic{'L', 'E', 'D', 'S'};
+constexpr std::uint16_t snapshot_version = 1;
+
+// A read-only mapping of a whole file.
+class MappedFile {
+  public:
+    explicit MappedFile(const std::filesystem::path& path) {
+#if defined(_WIN32)
+        file_ = ::CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file_ == INVALID_HANDLE_VALUE)
+            throw std::system_error(static_cast<int>(::GetLastError()), std::system_category(), "CreateFileW");
+
+        LARGE_INTEGER size;
+        if (!::GetFileSizeEx(file_, &size)) {
+            const int error = static_cast<int>(::GetLastError());
+            ::CloseHandle(file_);
+            throw std::system_error(error, std::system_category(), "GetFileSizeEx");
+        }
+        size_ = static_cast<std::size_t>(size.QuadPart);
+
+        // An empty file cannot be mapped, and is not a valid snapshot anyway.
+        if (size_ == 0)
+            return;
+
+        mapping_ = ::CreateFileMappingW(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping_)
+            data_ = static_cast<const std::byte*>(::MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+
+        if (!data_) {
+            const int error = static_cast<int>(::GetLastError());
+            if (mapping_)
+                ::CloseHandle(mapping_);
+            ::CloseHandle(file_);
+            throw std::system_error(error, std::system_category(), "MapViewOfFile");
+        }
+#else
+        fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd_ < 0)
+            throw std::system_error(errno, std::system_category(), "open");
+
+        struct stat info;
+        if (::fstat(fd_, &info) < 0) {
+            const int error = errno;
+            ::close(fd_);
+            throw std::system_error(error, std::system_category(), "fstat");
+        }
+        size_ = static_cast<std::size_t>(info.st_size);
+
+        // An empty file cannot be mapped, and is not a valid snapshot anyway.
+        if (size_ == 0)
+            return;
+
+        // The whole file is read right away, so fault it in with the mapping: with `MAP_POPULATE` on Linux, with a
+        // best-effort `madvise()` elsewhere.
+    #if defined(MAP_POPULATE)
+        void* map = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd_, 0);
+    #else
+        void* map = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+    #endif
+        if (map == MAP_FAILED) {
+            const int error = errno;
+            ::close(fd_);
+            throw std::system_error(error, std::system_category(), "mmap");
+        }
+    #if !defined(MAP_POPULATE)
+        ::madvise(map, size_, MADV_WILLNEED);
+    #endif
+        data_ = static_cast<const std::byte*>(map);
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() noexcept {
+#if defined(_WIN32)
+        if (data_)
+            ::UnmapViewOfFile(data_);
+        if (mapping_)
+            ::CloseHandle(mapping_);
+        ::CloseHandle(file_);
+#else
+        if (data_)
+            ::munmap(const_cast<std::byte*>(data_), size_);
+        ::close(fd_);
+#endif
+    }
+
+    std::span<const std::byte> data() const noexcept {
+        return {data_, data_ ? size_ : 0};
+    }
+
+  private:
+#if defined(_WIN32)
+    HANDLE file_{INVALID_HANDLE_VALUE};
+    HANDLE mapping_{};
+#else
+    int fd_{-1};
+#endif
+    const std::byte* data_{};
+    std::size_t size_{};
+};
+
+// Flush the data of a written file to the storage device.
+void SYNC_FILE(const std::filesystem::path& path) {
+#if defined(_WIN32)
+    const HANDLE file = ::CreateFileW(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                      FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        throw std::system_error(static_cast<int>(::GetLastError()), std::system_category(), "CreateFileW");
+
+    const bool flushed = ::FlushFileBuffers(file);
+    const int error = static_cast<int>(::GetLastError());
+    ::CloseHandle(file);
+    if (!flushed)
+        throw std::system_error(error, std::system_category(), "FlushFileBuffers");
+#else
+    const int fd = ::open(path.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd < 0)
+        throw std::system_error(errno, std::system_category(), "open");
+
+    const int result = ::fsync(fd);
+    const int error = errno;
+    ::close(fd);
+    if (result < 0)
+        throw std::system_error(error, std::system_category(), "fsync");
+#endif
+}
+
+} // namespace
+
+void LEDriver::ControllerArray::save(const std::filesystem::path& path) const {
+    using namespace std::chrono;
+
+    // Steady clock times do not survive a restart, so ages are stored as wall clock times.
+    const auto steady_now = steady_clock::now();
+    const auto system_now = system_clock::now();
+
+    std::vector<SnapshotRecord> records;
+    records.reserve(controllers_.size());
+
+    for (const Controller& ctl : controllers_) {
+        if (!ctl.is_valid())
+            continue;
+
+        SnapshotRecord& record = records.emplace_back();
+        if (ctl.addr_.ss_family == AF_INET) {
+            const sockaddr_in* in = reinterpret_cast<const sockaddr_in*>(&ctl.addr_);
+            record.family = 4;
+            record.port = in->sin_port;
+            std::memcpy(record.address.data(), &in->sin_addr, sizeof(in->sin_addr));
+        } else {
+            const sockaddr_in6* in6 = reinterpret_cast<const sockaddr_in6*>(&ctl.addr_);
+            record.family = 6;
+            record.port = in6->sin6_port;
+            record.scope_id = SERIALIZE_U32(static_cast<std::uint32_t>(in6->sin6_scope_id));
+            std::memcpy(record.address.data(), &in6->sin6_addr, sizeof(in6->sin6_addr));
+        }
+
+        record.color = TO_NET_ENDIAN(ctl.color_state_cache_.load(std::memory_order_relaxed));
+
+        // Read the times first, as `Controller::cached_status()` does. A field never written does not count.
+        const steady_clock::rep color_time = ctl.color_time_.load(std::memory_order_acquire);
+        const steady_clock::rep power_time = ctl.power_time_.load(std::memory_order_acquire);
+        const steady_clock::rep written =
+            color_time != 0 && power_time != 0 ? std::min(color_time, power_time) : std::max(color_time, power_time);
+        record.status = TO_NET_ENDIAN(ctl.status_cache_.load(std::memory_order_acquire));
+
+        if (written != 0) {
+            const auto wall = system_now - (steady_now - steady_clock::time_point(steady_clock::duration(written)));
+            record.status_time = TO_NET_ENDIAN(static_cast<std::uint64_t>(
+                std::max<nanoseconds::rep>(duration_cast<nanoseconds>(wall.time_since_epoch()).count(), 1)));
+        }
+    }
+
+    SnapshotHeader header{};
+    header.magic = snapshot_magic;
+    header.version = SERIALIZE_U16(snapshot_version);
+    header.record_size = SERIALIZE_U16(sizeof(SnapshotRecord));
+    header.count = SERIALIZE_U32(static_cast<std::uint32_t>(records.size()));
+
+    // Write next to the target, sync and rename, so a crash or a power loss never leaves a torn snapshot behind.
+    std::filesystem::path temporary = path;
+    temporary += ".tmp";
+
+    try {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(records.data()),
+                  static_cast<std::streamsize>(records.size() * sizeof(SnapshotRecord)));
+        out.close();
+
+        if (!out)
+            throw std::system_error(EIO, std::generic_category(), "write");
+
+        // Without it the rename may reach the disk before the data does.
+        SYNC_FILE(temporary);
+    } catch (...) {
+        std::error_code ignored;
+        std::filesystem::remove(temporary, ignored);
+        throw;
+    }
+
+    std::filesystem::rename(temporary, path);
+}
+
+std::size_t LEDriver::ControllerArray::restore(const std::filesystem::path& path, std::chrono::milliseconds timeout) {
+    using namespace std::chrono;
+
+    const MappedFile file(path);
+    const std::span<const std::byte> data = file.data();
+
+    SnapshotHeader header;
+    if (data.size() < sizeof(header))
+        throw std::system_error(EINVAL, std::generic_category());
+    std::memcpy(&header, data.data(), sizeof(header));
+
+    const std::size_t count = DESERIALIZE_U32(header.count);
+    if (header.magic != snapshot_magic || DESERIALIZE_U16(header.version) != snapshot_version ||
+        DESERIALIZE_U16(header.record_size) != sizeof(SnapshotRecord) ||
+        (data.size() - sizeof(header)) / sizeof(SnapshotRecord) < count)
+        throw std::system_error(EINVAL, std::generic_category());
+
+    const auto steady_now = steady_clock::now();
+    const auto system_now = system_clock::now();
+
+    // Controllers are created before any is added, so a failure leaves the array untouched.
+    std::vector<Controller> restored;
+    std::vector<std::uint64_t> colors;
+    restored.reserve(count);
+    colors.reserve(count);
+
+    const std::byte* cursor = data.data() + sizeof(header);
+    for (std::size_t i = 0; i < count; i++, cursor += sizeof(SnapshotRecord)) {
+        SnapshotRecord record;
+        std::memcpy(&record, cursor, sizeof(record));
+
+        sockaddr_storage addr{};
+        if (record.family == 4) {
+            sockaddr_in* in = reinterpret_cast<sockaddr_in*>(&addr);
+            in->sin_family = AF_INET;
+            in->sin_port = record.port;
+            std::memcpy(&in->sin_addr, record.address.data(), sizeof(in->sin_addr));
+        } else if (record.family == 6) {
+            sockaddr_in6* in6 = reinterpret_cast<sockaddr_in6*>(&addr);
+            in6->sin6_family = AF_INET6;
+            in6->sin6_port = record.port;
+            in6->sin6_scope_id = DESERIALIZE_U32(record.scope_id);
+            std::memcpy(&in6->sin6_addr, record.address.data(), sizeof(in6->sin6_addr));
+        } else {
+            throw std::system_error(EINVAL, std::generic_category());
+        }
+
+        Controller& ctl = restored.emplace_back(addr, timeout);
+
+        // Age the status cache by the time it had when saved, plus the downtime.
+        if (const std::uint64_t wall = TO_NET_ENDIAN(record.status_time); wall != 0) {
+            const auto saved = system_clock::time_point(duration_cast<system_clock::duration>(nanoseconds(wall)));
+            const auto age = std::max(system_now - saved, system_clock::duration::zero());
+            const auto written = steady_now - duration_cast<steady_clock::duration>(age);
+
+            const auto time = std::max<steady_clock::rep>(written.time_since_epoch().count(), 1);
+            ctl.status_cache_.store(TO_NET_ENDIAN(record.status), std::memory_order_relaxed);
+            ctl.color_time_.store(time, std::memory_order_relaxed);
+            ctl.power_time_.store(time, std::memory_order_relaxed);
+        }
+
+        // The driver may have lost its color meanwhile, so it is sent again rather than deduped.
+        ctl.color_state_cache_.store(Controller::color_unknown, std::memory_order_relaxed);
+        colors.push_back(TO_NET_ENDIAN(record.color));
+    }
+
+    reserve(controllers_.size() + count);
+    for (std::size_t i = 0; i < count; i++)
+        requested_[add(std::move(restored[i]))] = colors[i];
+
+    // Push the whole scene in one batch.
+    flush();
+
+    return count;
+}
@@ -1,35 +1,74 @@
-#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <optional>
 
 #include <ledriver.hpp>
+#include <metrics.hpp>
 #include <tools.hpp>
 
 LEDriver::Status LEDriver::Controller::status() {
     if (!is_valid())
         throw std::system_error(ENOTCONN, std::generic_category());
 
-    RootHeader status_header{};
-    status_header.magic = SERIALIZE_U32(RootHeader::magic_value);
-    status_header.version = RootHeader::protocol_version;
-    status_header.action = SERIALIZE_ACTION(Action::STATUS);
-    status_header.flags = 0;
+    // Keep concurrent exchanges from reading each other's replies.
+    const std::lock_guard lock(exchange_mutex_);
+
+    const RootHeader status_header = MAKE_HEADER(Action::STATUS, next_sequence_());
+
+    Metrics* metrics = metrics_.load(std::memory_order_acquire);
+    const auto sent = std::chrono::steady_clock::now();
 
     send_({TO_CIOV(status_header)});
 
-    std::byte buffer[sizeof(RootHeader) + 6 /* color state */ + 1 /* power state */];
-    if (recv_({buffer}) != sizeof(buffer))
+    // The reply header is checked against the request, stale replies are dropped.
+    std::byte buffer[StatusReplyFrame::size];
+    const std::size_t size = recv_reply_(status_header, buffer);
+    if (!StatusReplyFrame::is_reply({buffer, size}, status_header)) {
+        if (metrics)
+            metrics->short_replies_.fetch_add(1, std::memory_order_relaxed);
         throw std::system_error(EIO, std::generic_category());
+    }
+
+    const auto rtt = std::chrono::steady_clock::now() - sent;
+    rtt_sample_(rtt);
+    if (metrics)
+        metrics->rtt_(Action::STATUS, rtt);
+
+    const Status status = PARSE_STATUS(buffer);
+    cache_status_(status);
+
+    return status;
+}
+
+LEDriver::Status LEDriver::Controller::status(std::chrono::milliseconds max_age) {
+    if (const auto cached = cached_status(max_age))
+        return *cached;
+
+    return status();
+}
+
+std::optional<LEDriver::Status> LEDriver::Controller::cached_status(std::chrono::milliseconds max_age) const noexcept {
 
-    // TODO: check result header validity.
+    // Read the times first, so a concurrent write makes the cache look older rather than fresher. The older field
+    // decides the age of the whole status.
+    const std::chrono::steady_clock::time_point written(std::chrono::steady_clock::duration(
+        std::min(color_time_.load(std::memory_order_acquire), power_time_.load(std::memory_order_acquire))));
+    const std::uint64_t cached = status_cache_.load(std::memory_order_acquire);
 
-    std::uint16_t r_ne, g_ne, b_ne;
-    std::uint8_t power;
+    if ((cached & (status_color_known | status_power_known)) != (status_color_known | status_power_known))
+        return std::nullopt;
 
-    std::memcpy(&r_ne, buffer + 8, 2);
-    std::memcpy(&g_ne, buffer + 10, 2);
-    std::memcpy(&b_ne, buffer + 12, 2);
-    std::memcpy(&power, buffer + 14, 1);
+    const auto now = std::chrono::steady_clock::now();
+    if (max_age.count() < 0 || now - written > max_age)
+        return std::nullopt;
 
-    ColorState color_state{DESERIALIZE_U16(r_ne), DESERIALIZE_U16(g_ne), DESERIALIZE_U16(b_ne)};
+    // While a fade runs the driver shows an intermediate color, predicted by the mirror of the fade.
+    std::uint64_t color = cached & status_color_mask;
+    if (const auto fading = fade_color_(now)) {
+        if (*fading == color_unknown)
+            return std::nullopt;
+        color = *fading;
+    }
 
-    return {color_state, static_cast<bool>(power)};
+    return Status{UNPACK_COLOR(color), (cached & status_power_bit) != 0};
 }
\ No newline at end of file
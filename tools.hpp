@@ -1,18 +1,61 @@
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <compare>
+#include <concepts>
+#include <span>
+#include <system_error>
+#include <tuple>
+#include <utility>
+
+#include <cerrno>
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
 
 #if defined(_WIN32)
     #include <winsock2.h>
     #include <ws2tcpip.h>
 
     #pragma comment(lib, "Ws2_32.lib")
+
+    #define GET_SOCKET_ERROR() ::WSAGetLastError()
 #else
     #include <netinet/in.h>
+    #include <poll.h>
+    #include <sys/socket.h>
+
+    #define GET_SOCKET_ERROR() errno
 #endif
 
 #include <ledriver.hpp>
+#include <trace.hpp>
 
 namespace {
 
+#if defined(_WIN32)
+//! Keeps Winsock initialized for the lifetime of the program. See `INIT_SOCKETS()`.
+struct WSAInit {
+    WSAInit() {
+        WSADATA w{};
+        if (const int result = ::WSAStartup(MAKEWORD(2, 2), &w); result != 0)
+            throw std::system_error(result, std::system_category(), "WSAStartup");
+    }
+
+    ~WSAInit() {
+        ::WSACleanup();
+    }
+};
+#endif
+
+//! Initialize the system network layer before the first socket is created. Does nothing outside Windows.
+inline void INIT_SOCKETS() {
+#if defined(_WIN32)
+    static WSAInit wsa;
+#endif
+}
+
 //! Serialize `Action` to `u8`.
 constexpr inline std::uint8_t SERIALIZE_ACTION(LEDriver::Action action) noexcept {
     return static_cast<std::uint8_t>(action);
@@ -23,24 +66,42 @@ constexpr inline LEDriver::Action DESERIALIZE_ACTION(std::uint8_t action) noexce
     return static_cast<LEDriver::Action>(action);
 };
 
+//! Reverse the byte order of an unsigned integer. Usable in constant expressions, unlike `htons()` and friends.
+template <std::unsigned_integral T> constexpr inline T BYTESWAP(T value) noexcept {
+    T swapped{};
+    for (std::size_t i = 0; i < sizeof(T); i++) {
+        swapped = static_cast<T>(swapped << 8 | (value & 0xFF));
+        value = static_cast<T>(value >> 8);
+    }
+    return swapped;
+}
+
+//! Convert an unsigned integer between host and network endian. The conversion is symmetric.
+template <std::unsigned_integral T> constexpr inline T TO_NET_ENDIAN(T value) noexcept {
+    if constexpr (std::endian::native == std::endian::big)
+        return value;
+    else
+        return BYTESWAP(value);
+}
+
 //! Serialize `u16` from host endian to network endian.
-inline std::uint16_t SERIALIZE_U16(std::uint16_t u16_he) noexcept {
-    return ::htons(u16_he);
+constexpr inline std::uint16_t SERIALIZE_U16(std::uint16_t u16_he) noexcept {
+    return TO_NET_ENDIAN(u16_he);
 };
 
 //! Deserialize `u16` from network endian to host endian.
-inline std::uint16_t DESERIALIZE_U16(std::uint16_t u16_ne) noexcept {
-    return ::ntohs(u16_ne);
+constexpr inline std::uint16_t DESERIALIZE_U16(std::uint16_t u16_ne) noexcept {
+    return TO_NET_ENDIAN(u16_ne);
 };
 
 //! Serialize `u32` from host endian to network endian.
-inline std::uint32_t SERIALIZE_U32(std::uint32_t u32_he) noexcept {
-    return ::htonl(u32_he);
+constexpr inline std::uint32_t SERIALIZE_U32(std::uint32_t u32_he) noexcept {
+    return TO_NET_ENDIAN(u32_he);
 };
 
 //! Deserialize `u32` from network endian to host endian.
-inline std::uint32_t DESERIALIZE_U32(std::uint32_t u32_ne) noexcept {
-    return ::ntohl(u32_ne);
+constexpr inline std::uint32_t DESERIALIZE_U32(std::uint32_t u32_ne) noexcept {
+    return TO_NET_ENDIAN(u32_ne);
 };
 
 //! Create `std::span<std::byte>` from any trivially copyable type object.
@@ -53,4 +114,536 @@ template <typename T> constexpr inline std::span<const std::byte> TO_CIOV(const
     return {reinterpret_cast<const std::byte*>(&data), sizeof(data)};
 }
 
-} // namespace
\ No newline at end of file
+//! Pack `ColorState` into the low 48 bits of `u64`, so it can be stored in a single atomic.
+constexpr inline std::uint64_t PACK_COLOR(const LEDriver::ColorState& state) noexcept {
+    return static_cast<std::uint64_t>(state.r) | static_cast<std::uint64_t>(state.g) << 16 |
+           static_cast<std::uint64_t>(state.b) << 32;
+}
+
+//! Unpack `ColorState` from the low 48 bits of `u64`. See `PACK_COLOR()`.
+constexpr inline LEDriver::ColorState UNPACK_COLOR(std::uint64_t packed) noexcept {
+    return {static_cast<std::uint16_t>(packed), static_cast<std::uint16_t>(packed >> 16),
+            static_cast<std::uint16_t>(packed >> 32)};
+}
+
+//! Create a `RootHeader` for the action, serialized to network endian.
+constexpr inline LEDriver::RootHeader MAKE_HEADER(LEDriver::Action action, std::uint16_t flags = 0) noexcept {
+    LEDriver::RootHeader header{};
+    header.magic = SERIALIZE_U32(LEDriver::RootHeader::magic_value);
+    header.version = LEDriver::RootHeader::protocol_version;
+    header.action = SERIALIZE_ACTION(action);
+    header.flags = SERIALIZE_U16(flags);
+    return header;
+}
+
+//! Check whether PONG frame matches the PING frame. Both frames must be the same.
+inline bool IS_PONG(const LEDriver::RootHeader& ping, const LEDriver::RootHeader& pong) noexcept {
+    return ping.magic == pong.magic && ping.version == pong.version && ping.action == pong.action &&
+           ping.flags == pong.flags;
+}
+
+//! Wire encoding of a frame payload field of type `T`. See `FrameLayout`.
+template <typename T> struct FieldCodec;
+
+//! `u8` field.
+template <> struct FieldCodec<std::uint8_t> {
+    static constexpr std::size_t size = 1;
+
+    static constexpr void encode(std::byte* at, std::uint8_t value) noexcept {
+        at[0] = static_cast<std::byte>(value);
+    }
+
+    static constexpr std::uint8_t decode(const std::byte* at) noexcept {
+        return static_cast<std::uint8_t>(at[0]);
+    }
+};
+
+//! `u16` field, in network endian.
+template <> struct FieldCodec<std::uint16_t> {
+    static constexpr std::size_t size = 2;
+
+    static constexpr void encode(std::byte* at, std::uint16_t value) noexcept {
+        at[0] = static_cast<std::byte>(value >> 8);
+        at[1] = static_cast<std::byte>(value);
+    }
+
+    static constexpr std::uint16_t decode(const std::byte* at) noexcept {
+        return static_cast<std::uint16_t>(static_cast<std::uint16_t>(at[0]) << 8 | static_cast<std::uint16_t>(at[1]));
+    }
+};
+
+//! `u32` field, in network endian.
+template <> struct FieldCodec<std::uint32_t> {
+    static constexpr std::size_t size = 4;
+
+    static constexpr void encode(std::byte* at, std::uint32_t value) noexcept {
+        for (std::size_t i = 0; i < size; i++)
+            at[i] = static_cast<std::byte>(value >> (8 * (size - 1 - i)));
+    }
+
+    static constexpr std::uint32_t decode(const std::byte* at) noexcept {
+        std::uint32_t value{};
+        for (std::size_t i = 0; i < size; i++)
+            value = value << 8 | static_cast<std::uint32_t>(at[i]);
+        return value;
+    }
+};
+
+//! `u64` field, in network endian.
+template <> struct FieldCodec<std::uint64_t> {
+    static constexpr std::size_t size = 8;
+
+    static constexpr void encode(std::byte* at, std::uint64_t value) noexcept {
+        for (std::size_t i = 0; i < size; i++)
+            at[i] = static_cast<std::byte>(value >> (8 * (size - 1 - i)));
+    }
+
+    static constexpr std::uint64_t decode(const std::byte* at) noexcept {
+        std::uint64_t value{};
+        for (std::size_t i = 0; i < size; i++)
+            value = value << 8 | static_cast<std::uint64_t>(at[i]);
+        return value;
+    }
+};
+
+//! Boolean field: u8 containing 0x00 (`false`) or 0x01 (`true`). Any other value decodes as `true`.
+template <> struct FieldCodec<bool> {
+    static constexpr std::size_t size = 1;
+
+    static constexpr void encode(std::byte* at, bool value) noexcept {
+        at[0] = value ? std::byte{0x01} : std::byte{0x00};
+    }
+
+    static constexpr bool decode(const std::byte* at) noexcept {
+        return at[0] != std::byte{0x00};
+    }
+};
+
+//! `FadeCurve` field: u8. Unknown values decode as they are, the driver treats them as `FadeCurve::LINEAR`.
+template <> struct FieldCodec<LEDriver::FadeCurve> {
+    static constexpr std::size_t size = 1;
+
+    static constexpr void encode(std::byte* at, LEDriver::FadeCurve value) noexcept {
+        at[0] = static_cast<std::byte>(value);
+    }
+
+    static constexpr LEDriver::FadeCurve decode(const std::byte* at) noexcept {
+        return static_cast<LEDriver::FadeCurve>(at[0]);
+    }
+};
+
+//! `ColorState` field: channel brightness values (3 * u16) in network endian.
+template <> struct FieldCodec<LEDriver::ColorState> {
+    using Channel = FieldCodec<std::uint16_t>;
+
+    static constexpr std::size_t size = 3 * Channel::size;
+
+    static constexpr void encode(std::byte* at, const LEDriver::ColorState& state) noexcept {
+        Channel::encode(at, state.r);
+        Channel::encode(at + 2, state.g);
+        Channel::encode(at + 4, state.b);
+    }
+
+    static constexpr LEDriver::ColorState decode(const std::byte* at) noexcept {
+        return {Channel::decode(at), Channel::decode(at + 2), Channel::decode(at + 4)};
+    }
+};
+
+/*!
+    \brief Compile-time description of a fixed-size frame: `RootHeader` for the action `A` followed by the payload
+           fields `Fields`, packed in order.
+
+    The encoder and the decoder are generated from the layout, with every size and offset known at compile time, so
+    they fold into fixed-width loads and stores. The constant part of the header is computed at compile time as well.
+*/
+template <LEDriver::Action A, typename... Fields> struct FrameLayout {
+    static constexpr LEDriver::Action action = A;
+
+    //! Size of the payload in bytes.
+    static constexpr std::size_t payload_size = (std::size_t{0} + ... + FieldCodec<Fields>::size);
+
+    //! Size of the whole frame in bytes.
+    static constexpr std::size_t size = sizeof(LEDriver::RootHeader) + payload_size;
+
+    //! Serialized frame.
+    using Bytes = std::array<std::byte, size>;
+
+    //! Serialize a frame with the header flags `flags` (host endian) and the payload `fields`.
+    static constexpr Bytes encode(std::uint16_t flags, const Fields&... fields) noexcept {
+        using HeaderBytes = std::array<std::byte, sizeof(LEDriver::RootHeader)>;
+
+        Bytes bytes{};
+        const auto header = std::bit_cast<HeaderBytes>(MAKE_HEADER(action, flags));
+        std::copy(header.begin(), header.end(), bytes.begin());
+
+        std::size_t offset = sizeof(LEDriver::RootHeader);
+        ((FieldCodec<Fields>::encode(bytes.data() + offset, fields), offset += FieldCodec<Fields>::size), ...);
+
+        return bytes;
+    }
+
+    //! Serialize a frame with the header flags `flags` (host endian) and a zeroed payload. See `FrameTemplate`.
+    static constexpr Bytes blank(std::uint16_t flags) noexcept {
+        return encode(flags, Fields{}...);
+    }
+
+    //! Type of the `I`-th payload field.
+    template <std::size_t I> using Field = std::tuple_element_t<I, std::tuple<Fields...>>;
+
+    //! Overwrite the `I`-th payload field of a serialized frame, leaving the rest of it untouched.
+    template <std::size_t I> static constexpr void set(Bytes& frame, const Field<I>& value) noexcept {
+        FieldCodec<Field<I>>::encode(frame.data() + offset_<I>, value);
+    }
+
+    //! Deserialize the payload fields of a frame. The header is not checked, see `FrameLayout::is_reply()`.
+    static constexpr std::tuple<Fields...> decode(std::span<const std::byte, size> frame) noexcept {
+        return decode_(frame, std::index_sequence_for<Fields...>{});
+    }
+
+    /*!
+        \return `true` when `frame` has the size of this layout and its header matches the `request` header: same
+                magic, version, action and sequence number.
+    */
+    static bool is_reply(std::span<const std::byte> frame, const LEDriver::RootHeader& request) noexcept {
+        if (frame.size() != size)
+            return false;
+
+        LEDriver::RootHeader header;
+        std::memcpy(&header, frame.data(), sizeof(header));
+
+        constexpr std::uint16_t mask = SERIALIZE_U16(LEDriver::RootHeader::sequence_mask);
+        return header.magic == request.magic && header.version == request.version &&
+               header.action == SERIALIZE_ACTION(action) && (header.flags & mask) == (request.flags & mask);
+    }
+
+  private:
+    //! Offset of the `I`-th payload field in the frame.
+    template <std::size_t I> static constexpr std::size_t offset_ = [] {
+        constexpr std::size_t sizes[]{FieldCodec<Fields>::size..., 0};
+
+        std::size_t offset = sizeof(LEDriver::RootHeader);
+        for (std::size_t i = 0; i < I; i++)
+            offset += sizes[i];
+        return offset;
+    }();
+
+    template <std::size_t... I>
+    static constexpr std::tuple<Fields...> decode_(std::span<const std::byte, size> frame,
+                                                   std::index_sequence<I...>) noexcept {
+        return {FieldCodec<Fields>::decode(frame.data() + offset_<I>)...};
+    }
+};
+
+//! PING request and PONG reply: header only, echoed by the driver.
+using PingFrame = FrameLayout<LEDriver::Action::PING>;
+
+//! UPDATE request: color state.
+using UpdateFrame = FrameLayout<LEDriver::Action::UPDATE, LEDriver::ColorState>;
+
+//! UPDATE request with `RootHeader::flag_timestamp`: presentation time (driver clock) and color state.
+using TimedUpdateFrame = FrameLayout<LEDriver::Action::UPDATE, std::uint64_t, LEDriver::ColorState>;
+
+//! PONG reply to a PING request with `RootHeader::flag_timestamp`: driver clock at the time of reply.
+using TimedPongFrame = FrameLayout<LEDriver::Action::PING, std::uint64_t>;
+
+//! POWER request: power state.
+using PowerFrame = FrameLayout<LEDriver::Action::POWER, bool>;
+
+//! SET_STATE request: color state and power state.
+using SetStateFrame = FrameLayout<LEDriver::Action::SET_STATE, LEDriver::ColorState, bool>;
+
+//! FADE request: target color state, duration in milliseconds and easing curve.
+using FadeFrame = FrameLayout<LEDriver::Action::FADE, LEDriver::ColorState, std::uint32_t, LEDriver::FadeCurve>;
+
+//! STATUS request: header only.
+using StatusRequestFrame = FrameLayout<LEDriver::Action::STATUS>;
+
+//! STATUS reply: color state and power state.
+using StatusReplyFrame = FrameLayout<LEDriver::Action::STATUS, LEDriver::ColorState, bool>;
+
+static_assert(UpdateFrame::size == 14 && PowerFrame::size == 9 && SetStateFrame::size == 15 &&
+                  StatusReplyFrame::size == 15 && FadeFrame::size == 19,
+              "Frame layouts must match the protocol");
+static_assert(PACK_COLOR(std::get<0>(UpdateFrame::decode(UpdateFrame::encode(0, {1, 2, 3})))) == 0x0003'0002'0001,
+              "UPDATE encoder and decoder must round-trip");
+
+/*!
+    \brief A frame of the layout `Layout` precomputed at compile time: the header with constant flags and a zeroed
+           payload.
+
+    Senders copy a template and patch only the payload fields in place with `FrameTemplate::set()`, so the header is
+    never rebuilt per frame. The whole frame is one contiguous buffer, sent as a single segment.
+*/
+template <typename Layout> struct FrameTemplate {
+    typename Layout::Bytes bytes;
+
+    //! Serialize the header with the flags `flags` (host endian).
+    constexpr explicit FrameTemplate(std::uint16_t flags = 0) noexcept : bytes(Layout::blank(flags)) {}
+
+    //! Patch the `I`-th payload field.
+    template <std::size_t I> constexpr void set(const typename Layout::template Field<I>& value) noexcept {
+        Layout::template set<I>(bytes, value);
+    }
+
+    //! \return The whole frame.
+    constexpr std::span<const std::byte, Layout::size> data() const noexcept {
+        return bytes;
+    }
+};
+
+//! UPDATE frame: patch the color state.
+inline constexpr FrameTemplate<UpdateFrame> UPDATE_FRAME{};
+
+//! UPDATE frame with `RootHeader::flag_timestamp`: patch the presentation time and the color state.
+inline constexpr FrameTemplate<TimedUpdateFrame> TIMED_UPDATE_FRAME{LEDriver::RootHeader::flag_timestamp};
+
+//! POWER frame: patch the power state.
+inline constexpr FrameTemplate<PowerFrame> POWER_FRAME{};
+
+//! SET_STATE frame: patch the color state and the power state.
+inline constexpr FrameTemplate<SetStateFrame> SET_STATE_FRAME{};
+
+static_assert(
+    [] {
+        auto frame = TIMED_UPDATE_FRAME;
+        frame.set<0>(0x0102'0304'0506'0708);
+        frame.set<1>({1, 2, 3});
+        return frame.bytes ==
+               TimedUpdateFrame::encode(LEDriver::RootHeader::flag_timestamp, 0x0102'0304'0506'0708, {1, 2, 3});
+    }(),
+    "Patched templates must match the encoder");
+
+//! \return Eased progress of a fade, see `FadeCurve`. `progress` must be in [0, 1].
+constexpr inline double EASE(LEDriver::FadeCurve curve, double progress) noexcept {
+    switch (curve) {
+    case LEDriver::FadeCurve::EASE_IN:
+        return progress * progress;
+    case LEDriver::FadeCurve::EASE_OUT:
+        return 1.0 - (1.0 - progress) * (1.0 - progress);
+    case LEDriver::FadeCurve::EASE_IN_OUT:
+        return progress * progress * (3.0 - 2.0 * progress);
+    default:
+        return progress;
+    }
+}
+
+/*!
+    \brief Color of a fade at `progress` (from 0 to 1), rounded per channel. The driver interpolates the same way, so
+           the client mirror of a fade predicts its colors.
+*/
+constexpr inline LEDriver::ColorState FADE_COLOR(const LEDriver::ColorState& from, const LEDriver::ColorState& to,
+                                                 LEDriver::FadeCurve curve, double progress) noexcept {
+    const double eased = EASE(curve, progress < 0.0 ? 0.0 : progress > 1.0 ? 1.0 : progress);
+    const auto channel = [eased](std::uint16_t a, std::uint16_t b) {
+        const double value = static_cast<double>(a) + (static_cast<double>(b) - static_cast<double>(a)) * eased;
+        return static_cast<std::uint16_t>(value + 0.5);
+    };
+    return {channel(from.r, to.r), channel(from.g, to.g), channel(from.b, to.b)};
+}
+
+//! Deserialize STATUS reply payload. The header is not checked, see `FrameLayout::is_reply()`.
+constexpr inline LEDriver::Status PARSE_STATUS(std::span<const std::byte, StatusReplyFrame::size> reply) noexcept {
+    const auto [color, power] = StatusReplyFrame::decode(reply);
+    return {color, power};
+}
+
+//! Get the length of the address stored in `sockaddr_storage`, as expected by socket functions.
+inline socklen_t SOCKADDR_LEN(const sockaddr_storage& addr) noexcept {
+    return addr.ss_family == AF_INET ? sizeof(sockaddr_in) : sizeof(sockaddr_in6);
+}
+
+//! Compare two IPv4/IPv6 addresses (family, address and port). Can be used to order addresses in containers.
+inline std::strong_ordering SOCKADDR_COMPARE(const sockaddr_storage& a, const sockaddr_storage& b) noexcept {
+    if (a.ss_family != b.ss_family)
+        return a.ss_family <=> b.ss_family;
+
+    if (a.ss_family == AF_INET) {
+        const auto& a4 = reinterpret_cast<const sockaddr_in&>(a);
+        const auto& b4 = reinterpret_cast<const sockaddr_in&>(b);
+        if (const int result = std::memcmp(&a4.sin_addr, &b4.sin_addr, sizeof(a4.sin_addr)); result != 0)
+            return result <=> 0;
+        return a4.sin_port <=> b4.sin_port;
+    }
+
+    const auto& a6 = reinterpret_cast<const sockaddr_in6&>(a);
+    const auto& b6 = reinterpret_cast<const sockaddr_in6&>(b);
+    if (const int result = std::memcmp(&a6.sin6_addr, &b6.sin6_addr, sizeof(a6.sin6_addr)); result != 0)
+        return result <=> 0;
+    return a6.sin6_port <=> b6.sin6_port;
+}
+
+//! Hash an IPv4/IPv6 address (family, address and port), consistently with `SOCKADDR_COMPARE()`.
+inline std::size_t SOCKADDR_HASH(const sockaddr_storage& addr) noexcept {
+    const std::byte* bytes;
+    std::size_t size;
+    std::uint16_t port;
+
+    if (addr.ss_family == AF_INET) {
+        const auto& in = reinterpret_cast<const sockaddr_in&>(addr);
+        bytes = reinterpret_cast<const std::byte*>(&in.sin_addr);
+        size = sizeof(in.sin_addr);
+        port = in.sin_port;
+    } else {
+        const auto& in6 = reinterpret_cast<const sockaddr_in6&>(addr);
+        bytes = reinterpret_cast<const std::byte*>(&in6.sin6_addr);
+        size = sizeof(in6.sin6_addr);
+        port = in6.sin6_port;
+    }
+
+    // FNV-1a.
+    std::uint64_t hash = 0xCBF29CE484222325ull ^ addr.ss_family;
+    for (std::size_t i = 0; i < size; i++)
+        hash = (hash ^ static_cast<std::uint8_t>(bytes[i])) * 0x100000001B3ull;
+    hash = (hash ^ port) * 0x100000001B3ull;
+
+    return static_cast<std::size_t>(hash);
+}
+
+//! Strict weak ordering of addresses for ordered containers. See `SOCKADDR_COMPARE()`.
+struct SockaddrLess {
+    bool operator()(const sockaddr_storage& a, const sockaddr_storage& b) const noexcept {
+        return SOCKADDR_COMPARE(a, b) < 0;
+    }
+};
+
+/*!
+    Wait until the socket has a datagram to read.
+
+    \param timeout - maximum wait time. Zero or negative waits without a time limit.
+
+    \return `false` on timeout.
+
+    \throw std::system_error - system network layer errors
+*/
+template <typename socket_t> inline bool WAIT_READABLE(socket_t fd, std::chrono::milliseconds timeout) {
+    const auto timeout_ms = timeout.count();
+    const int ms = timeout_ms <= 0          ? -1
+                   : timeout_ms > INT32_MAX ? INT32_MAX
+                                            : static_cast<int>(timeout_ms);
+
+#if defined(_WIN32)
+    WSAPOLLFD pfd{};
+    pfd.fd = fd;
+    pfd.events = POLLRDNORM;
+
+    const int result = ::WSAPoll(&pfd, 1, ms);
+    if (result == SOCKET_ERROR)
+        throw std::system_error(GET_SOCKET_ERROR(), std::system_category(), "WSAPoll");
+#else
+    pollfd pfd{};
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+
+    int result;
+    do
+        result = ::poll(&pfd, 1, ms);
+    while (result < 0 && errno == EINTR);
+
+    if (result < 0)
+        throw std::system_error(GET_SOCKET_ERROR(), std::system_category(), "poll");
+#endif
+
+    return result > 0;
+}
+
+//! Error code reported when no response arrived within the timeout, as the platform's `recv()` would report it.
+inline int TIMEOUT_ERROR() noexcept {
+#if defined(_WIN32)
+    return WSAETIMEDOUT;
+#else
+    return ETIMEDOUT;
+#endif
+}
+
+//! \return `true` when `code` reports a receive timeout, which Winsock and POSIX sockets report differently.
+inline bool IS_TIMEOUT(int code) noexcept {
+#if defined(_WIN32)
+    return code == WSAETIMEDOUT || code == WSAEWOULDBLOCK;
+#else
+    return code == ETIMEDOUT || code == EWOULDBLOCK || code == EAGAIN;
+#endif
+}
+
+/*!
+    \brief Mark datagrams of the socket with the DSCP of `priority` and, on Linux, its `SO_PRIORITY`.
+           Does nothing on Windows. See `LEDriver::Priority`.
+
+    \param fd - socket.
+    \param family - address family of the socket.
+    \param priority - priority class.
+
+    \throw std::system_error - system network layer errors
+*/
+template <typename socket_t> inline void SET_PRIORITY(socket_t fd, int family, LEDriver::Priority priority) {
+#if defined(_WIN32)
+    (void)fd;
+    (void)family;
+    (void)priority;
+#else
+    // DSCP takes the upper 6 bits of the IPv4 TOS and IPv6 traffic class octets.
+    constexpr int dscp[] = {0, 10, 46};
+    const int tos = dscp[static_cast<std::size_t>(priority)] << 2;
+
+    const int result = family == AF_INET ? ::setsockopt(fd, IPPROTO_IP, IP_TOS, &tos, sizeof(tos))
+                                         : ::setsockopt(fd, IPPROTO_IPV6, IPV6_TCLASS, &tos, sizeof(tos));
+    if (result < 0)
+        throw std::system_error(GET_SOCKET_ERROR(), std::system_category(), "setsockopt");
+
+    #if defined(__linux__)
+    // Set after the TOS, which Linux also maps to a priority of its own.
+    constexpr int band[] = {0, 2, 6};
+    const int value = band[static_cast<std::size_t>(priority)];
+    if (::setsockopt(fd, SOL_SOCKET, SO_PRIORITY, &value, sizeof(value)) < 0)
+        throw std::system_error(GET_SOCKET_ERROR(), std::system_category(), "setsockopt");
+    #endif
+#endif
+}
+
+/*!
+    \brief Timestamps of one traced system call, recorded with `LEDriver::trace_record_()` on `TraceScope::exit()`.
+           Without the `LEDRIVER_TRACING` CMake option the scope is empty and all its methods compile to nothing.
+*/
+class TraceScope {
+  public:
+#if defined(LEDRIVER_TRACING)
+    //! Mark the send or receive as queued.
+    explicit TraceScope(bool receive) noexcept {
+        event_.queued = std::chrono::steady_clock::now();
+        event_.receive = receive;
+    }
+
+    //! Mark the system call, or the routed wait of a shared socket, as entered.
+    void enter() noexcept {
+        event_.enter = std::chrono::steady_clock::now();
+    }
+
+    //! Mark the reply as seen available: the socket became readable, or the reply was routed to this receiver.
+    void arrive(std::chrono::steady_clock::time_point at = std::chrono::steady_clock::now()) noexcept {
+        event_.arrival = at;
+    }
+
+    /*!
+        \brief Mark the system call as returned and record the datagram. The action is read from its header, if
+               complete. A receive without `TraceScope::arrive()`, i.e. a blocking one, arrived at its return.
+    */
+    void exit(std::span<const std::byte> header, std::size_t bytes) noexcept {
+        event_.exit = std::chrono::steady_clock::now();
+        if (event_.receive && event_.arrival == std::chrono::steady_clock::time_point{})
+            event_.arrival = event_.exit;
+        event_.bytes = static_cast<std::uint32_t>(bytes);
+        if (header.size() >= sizeof(LEDriver::RootHeader) && bytes >= sizeof(LEDriver::RootHeader))
+            event_.action = static_cast<std::uint8_t>(header[offsetof(LEDriver::RootHeader, action)]);
+        LEDriver::trace_record_(event_);
+    }
+
+  private:
+    LEDriver::TraceEvent event_;
+#else
+    constexpr explicit TraceScope(bool) noexcept {}
+    constexpr void enter() noexcept {}
+    constexpr void arrive(std::chrono::steady_clock::time_point = {}) noexcept {}
+    constexpr void exit(std::span<const std::byte>, std::size_t) noexcept {}
+#endif
+};
+
+} // namespace
@@ -0,0 +1,214 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <ledriver.hpp>
+#include <trace.hpp>
+
+namespace {
+
+using trace_clock = std::chrono::steady_clock;
+
+// One event, guarded by a sequence lock: the sequence is odd while the slot is written.
+struct TraceSlot {
+    std::atomic<std::uint64_t> sequence{};
+    std::atomic<trace_clock::rep> queued{};
+    std::atomic<trace_clock::rep> enter{};
+    std::atomic<trace_clock::rep> exit{};
+    std::atomic<trace_clock::rep> arrival{};
+    std::atomic<std::uint64_t> packed{}; // bytes << 16 | action << 8 | receive
+};
+
+// Ring of a single writer thread. Rings of exited threads are handed to new threads, so their memory stays bounded
+// by the number of concurrent threads.
+struct TraceRing {
+    std::array<TraceSlot, LEDriver::trace_ring_size> slots;
+    std::atomic<std::uint64_t> head{};
+    std::atomic<std::uint64_t> floor{}; // Head at the last `clear_trace()`.
+    std::atomic<bool> owned{};
+    std::uint32_t thread{};
+};
+
+std::mutex rings_mutex;
+std::vector<std::unique_ptr<TraceRing>> rings;
+
+TraceRing* ACQUIRE_RING() {
+    const std::lock_guard lock(rings_mutex);
+
+    for (const auto& ring : rings) {
+        bool expected = false;
+        if (ring->owned.compare_exchange_strong(expected, true, std::memory_order_acquire))
+            return ring.get();
+    }
+
+    auto& ring = rings.emplace_back(std::make_unique<TraceRing>());
+    ring->owned.store(true, std::memory_order_relaxed);
+    ring->thread = static_cast<std::uint32_t>(rings.size() - 1);
+    return ring.get();
+}
+
+// Releases the ring of a thread on exit.
+struct RingOwner {
+    TraceRing* ring{};
+
+    ~RingOwner() noexcept {
+        if (ring)
+            ring->owned.store(false, std::memory_order_release);
+    }
+};
+
+thread_local RingOwner owner;
+
+const char* ACTION_NAME(std::uint8_t action) noexcept {
+    switch (static_cast<LEDriver::Action>(action)) {
+    case LEDriver::Action::NONE:
+        return "NONE";
+    case LEDriver::Action::PING:
+        return "PING";
+    case LEDriver::Action::UPDATE:
+        return "UPDATE";
+    case LEDriver::Action::POWER:
+        return "POWER";
+    case LEDriver::Action::STATUS:
+        return "STATUS";
+    case LEDriver::Action::UPDATE_PIXELS:
+        return "UPDATE_PIXELS";
+    case LEDriver::Action::SET_STATE:
+        return "SET_STATE";
+    case LEDriver::Action::FADE:
+        return "FADE";
+    }
+    return "UNKNOWN";
+}
+
+trace_clock::time_point LOAD_TIME(const std::atomic<trace_clock::rep>& time) noexcept {
+    return trace_clock::time_point(trace_clock::duration(time.load(std::memory_order_relaxed)));
+}
+
+// Chrome trace timestamps are microseconds.
+double MICROSECONDS(trace_clock::time_point time) noexcept {
+    return std::chrono::duration<double, std::micro>(time.time_since_epoch()).count();
+}
+
+} // namespace
+
+void LEDriver::trace_record_(const TraceEvent& event) noexcept {
+    if (!owner.ring) {
+        try {
+            owner.ring = ACQUIRE_RING();
+        } catch (...) {
+            return;
+        }
+    }
+
+    TraceRing& ring = *owner.ring;
+    const std::uint64_t head = ring.head.load(std::memory_order_relaxed);
+    TraceSlot& slot = ring.slots[head % trace_ring_size];
+
+    const std::uint64_t sequence = slot.sequence.load(std::memory_order_relaxed);
+    slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.queued.store(event.queued.time_since_epoch().count(), std::memory_order_relaxed);
+    slot.enter.store(event.enter.time_since_epoch().count(), std::memory_order_relaxed);
+    slot.exit.store(event.exit.time_since_epoch().count(), std::memory_order_relaxed);
+    slot.arrival.store(event.arrival.time_since_epoch().count(), std::memory_order_relaxed);
+    slot.packed.store(static_cast<std::uint64_t>(event.bytes) << 16 | static_cast<std::uint64_t>(event.action) << 8 |
+                          static_cast<std::uint64_t>(event.receive),
+                      std::memory_order_relaxed);
+
+    slot.sequence.store(sequence + 2, std::memory_order_release);
+    ring.head.store(head + 1, std::memory_order_release);
+}
+
+std::vector<LEDriver::TraceEvent> LEDriver::trace_events() {
+    std::vector<TraceEvent> events;
+
+    {
+        const std::lock_guard lock(rings_mutex);
+        for (const auto& ring : rings) {
+            const std::uint64_t head = ring->head.load(std::memory_order_acquire);
+            const std::uint64_t floor = ring->floor.load(std::memory_order_relaxed);
+            const std::uint64_t first = std::max(floor, head > trace_ring_size ? head - trace_ring_size : 0);
+
+            for (std::uint64_t i = first; i < head; i++) {
+                const TraceSlot& slot = ring->slots[i % trace_ring_size];
+
+                const std::uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+                if (sequence & 1)
+                    continue;
+
+                TraceEvent event;
+                event.queued = LOAD_TIME(slot.queued);
+                event.enter = LOAD_TIME(slot.enter);
+                event.exit = LOAD_TIME(slot.exit);
+                event.arrival = LOAD_TIME(slot.arrival);
+                const std::uint64_t packed = slot.packed.load(std::memory_order_relaxed);
+                event.bytes = static_cast<std::uint32_t>(packed >> 16);
+                event.action = static_cast<std::uint8_t>(packed >> 8);
+                event.receive = (packed & 1) != 0;
+                event.thread = ring->thread;
+
+                // A slot rewritten meanwhile holds a newer event of the same ring, which is dropped as torn.
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (slot.sequence.load(std::memory_order_relaxed) == sequence)
+                    events.push_back(event);
+            }
+        }
+    }
+
+    std::sort(events.begin(), events.end(),
+              [](const TraceEvent& a, const TraceEvent& b) { return a.queued < b.queued; });
+
+    return events;
+}
+
+void LEDriver::clear_trace() noexcept {
+    const std::lock_guard lock(rings_mutex);
+    for (const auto& ring : rings)
+        ring->floor.store(ring->head.load(std::memory_order_acquire), std::memory_order_relaxed);
+}
+
+void LEDriver::dump_trace(std::ostream& out) {
+    const auto events = trace_events();
+
+    const auto flags = out.flags();
+    const auto precision = out.precision();
+    out << std::fixed << std::setprecision(3);
+
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+
+    bool first = true;
+    for (const TraceEvent& event : events) {
+        const char* category = event.receive ? "recv" : "send";
+
+        out << (first ? "" : ",") << "\n{\"name\":\"" << ACTION_NAME(event.action) << "\",\"cat\":\"" << category
+            << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread << ",\"ts\":" << MICROSECONDS(event.queued)
+            << ",\"dur\":" << MICROSECONDS(event.exit) - MICROSECONDS(event.queued)
+            << ",\"args\":{\"bytes\":" << event.bytes << "}}";
+
+        out << ",\n{\"name\":\"" << (event.receive ? "recv" : "send") << "\",\"cat\":\"" << category
+            << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread << ",\"ts\":" << MICROSECONDS(event.enter)
+            << ",\"dur\":" << MICROSECONDS(event.exit) - MICROSECONDS(event.enter) << "}";
+
+        if (event.receive && event.arrival != std::chrono::steady_clock::time_point{})
+            out << ",\n{\"name\":\"arrival\",\"cat\":\"" << category << "\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":"
+                << event.thread << ",\"ts\":" << MICROSECONDS(event.arrival) << "}";
+
+        first = false;
+    }
+
+    out << "\n]}\n";
+
+    out.flags(flags);
+    out.precision(precision);
+}
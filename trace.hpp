@@ -0,0 +1,75 @@
+/*!
+    \file
+    \brief Header containing hot-path tracing of `Controller` system calls, with a dump to the Chrome trace format.
+    \copyright Copyright (c) 2026 Wiktor Sołtys
+    \cond
+        See LICENSE
+    \endcond
+*/
+#pragma once
+
+#include <chrono>
+#include <ostream>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace LEDriver {
+
+/*!
+    \brief Whether the library was built with the `LEDRIVER_TRACING` CMake option.
+
+    Without it the hooks in the send and receive paths compile to nothing, `trace_events()` is always empty and
+    `dump_trace()` writes an empty trace.
+*/
+#if defined(LEDRIVER_TRACING)
+constexpr bool tracing_enabled = true;
+#else
+constexpr bool tracing_enabled = false;
+#endif
+
+//! Number of events kept per thread. Older events are overwritten.
+constexpr std::size_t trace_ring_size = 4096;
+
+//! A single traced datagram sent or received by a `Controller`.
+struct TraceEvent {
+    std::chrono::steady_clock::time_point queued; //!< Send or receive requested, i.e. the reply wait started.
+    std::chrono::steady_clock::time_point enter;  //!< System call, or routed wait of a shared socket, entered.
+    std::chrono::steady_clock::time_point exit;   //!< System call returned.
+    //! Receive only: reply seen available, i.e. the socket became readable, the reply was routed to the mailbox of a
+    //! shared socket, or a blocking receive returned. Precedes `queued` when another receiver routed the reply early.
+    std::chrono::steady_clock::time_point arrival;
+    std::uint32_t bytes{};                        //!< Bytes sent or received.
+    std::uint8_t action{};                        //!< Action of the datagram, see `Action`. 0 when too short.
+    bool receive{};                               //!< Whether the datagram was received rather than sent.
+    std::uint32_t thread{};                       //!< Index of the tracing thread, assigned in order of first use.
+};
+
+/*!
+    \brief Copy the events recorded by all threads.
+
+    Each thread records into its own lock-free ring of `trace_ring_size` events, so this may be called at any time;
+    events being overwritten concurrently are skipped.
+
+    \return Events, ordered by `TraceEvent::queued`.
+*/
+std::vector<TraceEvent> trace_events();
+
+//! Forget all events recorded so far.
+void clear_trace() noexcept;
+
+/*!
+    \brief Write all recorded events in the Chrome trace JSON format, readable by `chrome://tracing` and Perfetto.
+
+    Every event is a slice from `TraceEvent::queued` to `TraceEvent::exit`, named after the action, with a nested
+    slice of the system call. Receives also get an instant event at `TraceEvent::arrival`.
+
+    \param out - output stream.
+*/
+void dump_trace(std::ostream& out);
+
+//! Record an event into the ring of the calling thread. Called by the library's send and receive paths.
+void trace_record_(const TraceEvent& event) noexcept;
+
+} // namespace LEDriver
@@ -1,3 +1,6 @@
+#include <chrono>
+#include <mutex>
+
 #include <ledriver.hpp>
 #include <tools.hpp>
 
@@ -5,20 +8,52 @@ void LEDriver::Controller::update(const ColorState& state) {
     if (!is_valid())
         throw std::system_error(ENOTCONN, std::generic_category());
 
+    const std::lock_guard lock(state_mutex_);
+
     // If the color state persists, do not send.
-    if (state == color_state_cache_)
+    const std::uint64_t packed = PACK_COLOR(state);
+    std::uint64_t previous;
+    if (!claim_color_(packed, previous))
         return;
 
-    RootHeader update_header{};
-    update_header.magic = SERIALIZE_U32(RootHeader::magic_value);
-    update_header.version = RootHeader::protocol_version;
-    update_header.action = SERIALIZE_ACTION(Action::UPDATE);
-    update_header.flags = 0;
+    // UPDATE action requires 6-byte payload (3 * u16), containing the channel brightness values in net endian.
+    // Patch them into a copy of the precomputed frame.
+    auto frame = UPDATE_FRAME;
+    frame.set<0>(state);
+
+    try {
+        send_({frame.data()});
+        cache_color_(state);
+    } catch (...) {
+        unclaim_color_(packed, previous);
+        throw;
+    }
+}
+
+void LEDriver::Controller::update_at(const ColorState& state, std::chrono::steady_clock::time_point at) {
+    if (!is_valid())
+        throw std::system_error(ENOTCONN, std::generic_category());
+
+    const std::uint64_t presentation = to_driver_time(at);
+
+    const std::lock_guard lock(state_mutex_);
 
-    // UPDATE action requires 6-byte payload (3 * u16), containing the channel brightness values ​​in net endian.
-    const std::uint16_t values[3]{SERIALIZE_U16(state.r), SERIALIZE_U16(state.g), SERIALIZE_U16(state.b)};
+    // If the color state persists, do not send.
+    const std::uint64_t packed = PACK_COLOR(state);
+    std::uint64_t previous;
+    if (!claim_color_(packed, previous))
+        return;
 
-    send_({TO_CIOV(update_header), TO_CIOV(values)});
+    // The presentation time precedes the usual UPDATE payload.
+    auto frame = TIMED_UPDATE_FRAME;
+    frame.set<0>(presentation);
+    frame.set<1>(state);
 
-    color_state_cache_ = state;
+    try {
+        send_({frame.data()});
+        cache_color_(state);
+    } catch (...) {
+        unclaim_color_(packed, previous);
+        throw;
+    }
 }
\ No newline at end of file
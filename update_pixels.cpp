@@ -0,0 +1,163 @@
+#include <algorithm>
+
+#include <ledriver.hpp>
+#include <tools.hpp>
+
+void LEDriver::Controller::update_pixels(std::span<const ColorState> pixels, std::uint16_t offset) {
+    if (!is_valid())
+        throw std::system_error(ENOTCONN, std::generic_category());
+
+    if (offset + pixels.size() > 0x10000)
+        throw std::system_error(EINVAL, std::generic_category());
+
+    constexpr RootHeader update_header = MAKE_HEADER(Action::UPDATE_PIXELS);
+
+    // UPDATE_PIXELS action requires payload containing u16 offset, u16 pixel count and the pixels (3 * u16 each),
+    // all in net endian.
+    std::uint16_t payload[2 + 3 * max_pixels_per_frame];
+
+    std::size_t done{};
+    while (done < pixels.size()) {
+        const std::size_t count = std::min(pixels.size() - done, max_pixels_per_frame);
+
+        payload[0] = SERIALIZE_U16(static_cast<std::uint16_t>(offset + done));
+        payload[1] = SERIALIZE_U16(static_cast<std::uint16_t>(count));
+        for (std::size_t i = 0; i < count; i++) {
+            payload[2 + 3 * i] = SERIALIZE_U16(pixels[done + i].r);
+            payload[3 + 3 * i] = SERIALIZE_U16(pixels[done + i].g);
+            payload[4 + 3 * i] = SERIALIZE_U16(pixels[done + i].b);
+        }
+
+        send_({TO_CIOV(update_header), std::as_bytes(std::span(payload, 2 + 3 * count))});
+
+        done += count;
+    }
+}
+
+void LEDriver::Controller::update_pixels(std::span<const std::byte> pixels, std::uint16_t offset) {
+    if (!is_valid())
+        throw std::system_error(ENOTCONN, std::generic_category());
+
+    constexpr std::size_t pixel_size = FieldCodec<ColorState>::size;
+    if (pixels.size() % pixel_size != 0 || offset + pixels.size() / pixel_size > 0x10000)
+        throw std::system_error(EINVAL, std::generic_category());
+
+    constexpr RootHeader update_header = MAKE_HEADER(Action::UPDATE_PIXELS);
+
+    // Only the range is serialized here, the pixels are gathered from the caller's buffer.
+    const std::size_t total = pixels.size() / pixel_size;
+    std::size_t done{};
+    while (done < total) {
+        const std::size_t count = std::min(total - done, max_pixels_per_frame);
+
+        const std::uint16_t range[2] = {SERIALIZE_U16(static_cast<std::uint16_t>(offset + done)),
+                                        SERIALIZE_U16(static_cast<std::uint16_t>(count))};
+
+        send_({TO_CIOV(update_header), TO_CIOV(range), pixels.subspan(done * pixel_size, count * pixel_size)});
+
+        done += count;
+    }
+}
+
+void LEDriver::Controller::update_pixels_delta(std::span<const ColorState> pixels, std::size_t keyframe_interval) {
+    if (!is_valid())
+        throw std::system_error(ENOTCONN, std::generic_category());
+
+    if (pixels.size() > 0x10000)
+        throw std::system_error(EINVAL, std::generic_category());
+
+    const std::lock_guard lock(pixels_mutex_);
+
+    // Send a key frame with all pixels when there is nothing to compare with, or when it's time to.
+    const bool keyframe_due = keyframe_interval != 0 && ++frames_since_keyframe_ >= keyframe_interval;
+    if (pixel_cache_.size() != pixels.size() || keyframe_due) {
+        pixel_cache_.clear();
+        update_pixels(pixels);
+        pixel_cache_.assign(pixels.begin(), pixels.end());
+        frames_since_keyframe_ = 0;
+        return;
+    }
+
+    constexpr RootHeader update_header = MAKE_HEADER(Action::UPDATE_PIXELS, RootHeader::flag_ranges);
+
+    // The ranged payload has the same capacity as a full UPDATE_PIXELS payload.
+    constexpr std::size_t capacity = 2 + 3 * max_pixels_per_frame;
+    constexpr std::size_t min_run = 3; // A shorter run is cheaper to send as a part of a literal range.
+
+    std::uint16_t payload[capacity];
+    std::size_t used{};
+
+    const auto flush = [&]() {
+        if (used == 0)
+            return;
+        send_({TO_CIOV(update_header), std::as_bytes(std::span(payload, used))});
+        used = 0;
+    };
+
+    const auto put_pixel = [&](const ColorState& pixel) {
+        payload[used++] = SERIALIZE_U16(pixel.r);
+        payload[used++] = SERIALIZE_U16(pixel.g);
+        payload[used++] = SERIALIZE_U16(pixel.b);
+    };
+
+    // Emit pixels [begin, end) as literal ranges, split across datagrams as needed.
+    const auto put_literal = [&](std::size_t begin, std::size_t end) {
+        while (begin < end) {
+            if (capacity - used < 2 + 3)
+                flush();
+
+            const std::size_t count = std::min(end - begin, (capacity - used - 2) / 3);
+            payload[used++] = SERIALIZE_U16(static_cast<std::uint16_t>(begin));
+            payload[used++] = SERIALIZE_U16(static_cast<std::uint16_t>(count));
+            for (std::size_t i = 0; i < count; i++)
+                put_pixel(pixels[begin + i]);
+
+            begin += count;
+        }
+    };
+
+    const auto put_run = [&](std::size_t begin, std::size_t count) {
+        if (capacity - used < 2 + 3)
+            flush();
+
+        payload[used++] = SERIALIZE_U16(static_cast<std::uint16_t>(begin));
+        payload[used++] = SERIALIZE_U16(static_cast<std::uint16_t>(count | RootHeader::run_bit));
+        put_pixel(pixels[begin]);
+    };
+
+    std::size_t i{};
+    while (i < pixels.size()) {
+
+        // Skip unchanged pixels.
+        if (pixels[i] == pixel_cache_[i]) {
+            i++;
+            continue;
+        }
+
+        // Find the end of the changed range.
+        std::size_t end = i + 1;
+        while (end < pixels.size() && !(pixels[end] == pixel_cache_[end]))
+            end++;
+
+        // Split the range into literal parts and runs of equal pixels.
+        std::size_t literal = i;
+        while (i < end) {
+            std::size_t run = i + 1;
+            while (run < end && run - i < (RootHeader::run_bit - 1) && pixels[run] == pixels[i])
+                run++;
+
+            if (run - i >= min_run) {
+                put_literal(literal, i);
+                put_run(i, run - i);
+                literal = run;
+            }
+
+            i = run;
+        }
+        put_literal(literal, end);
+    }
+
+    flush();
+
+    pixel_cache_.assign(pixels.begin(), pixels.end());
+}